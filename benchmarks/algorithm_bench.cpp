@@ -0,0 +1,99 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+
+#include "benchmark.h"
+#include "deque.h"
+#include "deque_algorithm.h"
+
+namespace {
+    const size_t algorithmElements = 1 << 20;
+
+    const struct {
+        Deque::SimdLevel level;
+        const char *name;
+    } simdLevels[] = {
+            {Deque::SimdLevel::SL_SCALAR, "scalar"},
+            {Deque::SimdLevel::SL_SSE2,   "sse2"},
+            {Deque::SimdLevel::SL_AVX2,   "avx2"}
+    };
+
+    // the std algorithms through DequeIterator against the block-wise kernels at each SIMD level; find looks
+    // for a value that is not there, so both scan everything
+    template <typename T>
+    void scan(DequeBenchmark::Runner &runner, const std::string &type) {
+        Deque::Deque <T> dq;
+
+        for (size_t i = 0; i < algorithmElements; ++i)
+            dq.push_back(static_cast<T>(i % 1000));
+
+        const T missing = static_cast<T>(-1);
+
+        runner.run("algorithm/find/std/" + type, algorithmElements, [&dq, missing] {
+            DequeBenchmark::doNotOptimize(std::find(dq.cbegin(), dq.cend(), missing));
+        });
+
+        runner.run("algorithm/count/std/" + type, algorithmElements, [&dq] {
+            DequeBenchmark::doNotOptimize(std::count(dq.cbegin(), dq.cend(), T(7)));
+        });
+
+        runner.run("algorithm/min_max/std/" + type, algorithmElements, [&dq] {
+            DequeBenchmark::doNotOptimize(std::minmax_element(dq.cbegin(), dq.cend()));
+        });
+
+        runner.run("algorithm/sum/std/" + type, algorithmElements, [&dq] {
+            DequeBenchmark::doNotOptimize(std::accumulate(dq.cbegin(), dq.cend(), Deque::SumType <T>(0)));
+        });
+
+        for (const auto &simd : simdLevels) {
+            Deque::limit_simd_level(simd.level);
+
+            if (Deque::simd_level() != simd.level)
+                continue;
+
+            std::string suffix = std::string("/") + simd.name + "/" + type;
+
+            runner.run("algorithm/find" + suffix, algorithmElements, [&dq, missing] {
+                DequeBenchmark::doNotOptimize(Deque::find(dq, missing));
+            });
+
+            runner.run("algorithm/count" + suffix, algorithmElements, [&dq] {
+                DequeBenchmark::doNotOptimize(Deque::count(dq, T(7)));
+            });
+
+            runner.run("algorithm/min_max" + suffix, algorithmElements, [&dq] {
+                DequeBenchmark::doNotOptimize(Deque::min_max(dq));
+            });
+
+            runner.run("algorithm/sum" + suffix, algorithmElements, [&dq] {
+                DequeBenchmark::doNotOptimize(Deque::sum(dq));
+            });
+        }
+
+        Deque::limit_simd_level(Deque::SimdLevel::SL_AVX2);
+    }
+}
+
+DEQUE_BENCHMARK(AlgorithmInt) {
+    scan <int>(runner, "int");
+}
+
+DEQUE_BENCHMARK(AlgorithmFloat) {
+    scan <float>(runner, "float");
+}
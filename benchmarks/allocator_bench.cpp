@@ -0,0 +1,76 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#include <string>
+
+#include "benchmark.h"
+#include "deque.h"
+
+namespace {
+    const size_t queueSizes[] = {16, 1024, 65536};
+
+    // a request-scoped queue: filled, drained from both ends and destroyed
+    template <typename DequeType>
+    void shortLived(DequeType &dq, size_t elements) {
+        for (size_t i = 0; i < elements; ++i) {
+            if (i % 2)
+                dq.push_back(static_cast<int>(i));
+            else
+                dq.push_front(static_cast<int>(i));
+        }
+
+        while (dq.size() > 1) {
+            dq.pop_front();
+            dq.pop_back();
+        }
+
+        DequeBenchmark::doNotOptimize(dq);
+    }
+}
+
+DEQUE_BENCHMARK(AllocatorGlobalNew) {
+    for (size_t elements : queueSizes) {
+        runner.run("allocator/global_new/" + std::to_string(elements), elements, [elements] {
+            Deque::Deque <int> dq;
+            shortLived(dq, elements);
+        });
+    }
+}
+
+#ifdef DEQUE_HAS_PMR
+DEQUE_BENCHMARK(AllocatorPool) {
+    for (size_t elements : queueSizes) {
+        std::pmr::unsynchronized_pool_resource pool;
+
+        runner.run("allocator/pool/" + std::to_string(elements), elements, [elements, &pool] {
+            Deque::pmr::Deque <int> dq(&pool);
+            shortLived(dq, elements);
+        });
+    }
+}
+
+DEQUE_BENCHMARK(AllocatorMonotonicArena) {
+    for (size_t elements : queueSizes) {
+        std::vector <char> buffer(8 * elements * sizeof(int) + 65536);
+
+        runner.run("allocator/monotonic_arena/" + std::to_string(elements), elements, [elements, &buffer] {
+            std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size());
+            Deque::pmr::Deque <int> dq(&arena);
+            shortLived(dq, elements);
+        });
+    }
+}
+#endif
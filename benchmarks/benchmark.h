@@ -0,0 +1,175 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#ifndef DEQUE_BENCHMARK_H
+#define DEQUE_BENCHMARK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace DequeBenchmark {
+    typedef std::chrono::steady_clock Clock;
+
+    const double minimalTime = 0.2;
+
+    template <typename T>
+    inline void doNotOptimize(const T &value) {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+
+    // one reported measurement: named values, plus the unit of reportCount values
+    struct Result {
+        std::string name;
+        std::vector <std::pair <const char *, double>> values;
+        const char *unit;
+    };
+
+    class Runner {
+    private:
+        std::string filter_;
+        std::vector <Result> results_;
+
+        static void writeString(std::FILE *file, const std::string &text) {
+            std::fputc('"', file);
+
+            for (char c : text) {
+                if (c == '"' || c == '\\')
+                    std::fputc('\\', file);
+
+                std::fputc(c, file);
+            }
+
+            std::fputc('"', file);
+        }
+
+    public:
+        explicit Runner(std::string filter) : filter_(std::move(filter)) {}
+
+        bool selected(const std::string &name) const {
+            return name.find(filter_) != std::string::npos;
+        }
+
+        void report(const std::string &name, double operations, double elapsed) {
+            std::printf("%-56s %12.2f ns/op %12.2f Mop/s\n", name.c_str(), elapsed * 1e9 / operations,
+                        operations / elapsed / 1e6);
+            results_.push_back(Result{name, {{"ns_per_op", elapsed * 1e9 / operations},
+                                             {"ops_per_second", operations / elapsed}}, nullptr});
+        }
+
+        void reportCount(const std::string &name, double value, const char *unit) {
+            std::printf("%-56s %12.2f %s\n", name.c_str(), value, unit);
+            results_.push_back(Result{name, {{"value", value}}, unit});
+        }
+
+        // prints percentiles of latency samples given in nanoseconds
+        void reportLatency(const std::string &name, std::vector <double> samples) {
+            if (samples.empty())
+                return;
+
+            std::sort(samples.begin(), samples.end());
+
+            double p50 = samples[samples.size() / 2];
+            double p99 = samples[samples.size() * 99 / 100];
+            double p999 = samples[samples.size() * 999 / 1000];
+
+            std::printf("%-56s p50 %8.0f ns  p99 %8.0f ns  p99.9 %8.0f ns  max %10.0f ns\n", name.c_str(), p50, p99,
+                        p999, samples.back());
+            results_.push_back(Result{name, {{"p50_ns", p50}, {"p99_ns", p99}, {"p999_ns", p999},
+                                             {"max_ns", samples.back()},
+                                             {"samples", static_cast<double>(samples.size())}}, nullptr});
+        }
+
+        // everything reported so far as {"context": {...}, "benchmarks": [{"name": ..., <values>}, ...]}
+        void writeJson(std::FILE *file) const {
+            std::fprintf(file, "{\n  \"context\": {\"hardware_threads\": %u, \"minimal_time_s\": %g},\n",
+                         std::thread::hardware_concurrency(), minimalTime);
+            std::fprintf(file, "  \"benchmarks\": [");
+
+            for (size_t i = 0; i < results_.size(); ++i) {
+                std::fprintf(file, "%s\n    {\"name\": ", i ? "," : "");
+                writeString(file, results_[i].name);
+
+                for (const std::pair <const char *, double> &value : results_[i].values)
+                    std::fprintf(file, ", \"%s\": %.17g", value.first, value.second);
+
+                if (results_[i].unit) {
+                    std::fprintf(file, ", \"unit\": ");
+                    writeString(file, results_[i].unit);
+                }
+
+                std::fprintf(file, "}");
+            }
+
+            std::fprintf(file, "\n  ]\n}\n");
+        }
+
+        // calls body repeatedly for at least minimalTime seconds; each call is counted as `operations` operations
+        template <typename Body>
+        void run(const std::string &name, size_t operations, Body body) {
+            if (!selected(name))
+                return;
+
+            size_t calls = 0;
+            double elapsed = 0;
+            Clock::time_point start = Clock::now();
+
+            while (elapsed < minimalTime) {
+                body();
+                ++calls;
+                elapsed = std::chrono::duration <double>(Clock::now() - start).count();
+            }
+
+            report(name, static_cast<double>(calls) * operations, elapsed);
+        }
+    };
+
+    // 1, 2, 4, ... threads, always ending with one thread per hardware thread
+    inline std::vector <size_t> threadCounts() {
+        size_t cores = std::max <size_t>(1, std::thread::hardware_concurrency());
+        std::vector <size_t> counts;
+
+        for (size_t threads = 1; threads < cores; threads *= 2)
+            counts.push_back(threads);
+
+        counts.push_back(cores);
+        return counts;
+    }
+
+    typedef void (*Function)(Runner &);
+
+    inline std::vector <std::pair <const char *, Function>> &registry() {
+        static std::vector <std::pair <const char *, Function>> benchmarks;
+        return benchmarks;
+    }
+
+    struct Registrar {
+        Registrar(const char *name, Function function) {
+            registry().emplace_back(name, function);
+        }
+    };
+}
+
+#define DEQUE_BENCHMARK(name) \
+    static void name(DequeBenchmark::Runner &runner); \
+    static DequeBenchmark::Registrar name##Registrar(#name, name); \
+    static void name(DequeBenchmark::Runner &runner)
+
+#endif //DEQUE_BENCHMARK_H
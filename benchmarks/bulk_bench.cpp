@@ -0,0 +1,103 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "deque.h"
+
+namespace {
+    const size_t batchSizes[] = {64, 4096, 65536};
+    const size_t batchesPerRun = 16;
+    const size_t middleEditSizes[] = {1000, 100000};
+    const size_t editsPerRun = 256;
+
+    // an insert and an erase at random positions, applied editsPerRun times
+    template <typename Edit>
+    void middleEdits(DequeBenchmark::Runner &runner, const std::string &name, size_t size, Edit edit) {
+        runner.run(name + "/" + std::to_string(size), 2 * editsPerRun, [size, edit] {
+            std::mt19937 random(3);
+
+            for (size_t i = 0; i < editsPerRun; ++i)
+                edit(random() % size, random() % size);
+        });
+    }
+}
+
+// a batch is ingested at the back and consumed from the front, as a network receive queue does
+DEQUE_BENCHMARK(BulkIngest) {
+    for (size_t batch_size : batchSizes) {
+        std::vector <uint8_t> batch(batch_size, 0x5a);
+        Deque::Deque <uint8_t> dq;
+        std::string suffix = "/" + std::to_string(batch_size);
+
+        runner.run("bulk/push_back_loop" + suffix, batch_size * batchesPerRun, [&] {
+            for (size_t i = 0; i < batchesPerRun; ++i) {
+                for (uint8_t byte : batch)
+                    dq.push_back(byte);
+            }
+
+            for (size_t i = 0; i < batchesPerRun * batch_size; ++i)
+                dq.pop_front();
+
+            DequeBenchmark::doNotOptimize(dq);
+        });
+
+        runner.run("bulk/append" + suffix, batch_size * batchesPerRun, [&] {
+            for (size_t i = 0; i < batchesPerRun; ++i)
+                dq.append(batch.data(), batch.data() + batch.size());
+
+            dq.pop_front_n(batchesPerRun * batch_size);
+
+            DequeBenchmark::doNotOptimize(dq);
+        });
+    }
+}
+
+// a sorted index kept up to date in place, against rebuilding it through a std::vector per edit
+DEQUE_BENCHMARK(BulkMiddleEdits) {
+    for (size_t size : middleEditSizes) {
+        Deque::Deque <int> dq;
+        std::deque <int> dq_std;
+
+        for (size_t i = 0; i < size; ++i) {
+            dq.push_back(static_cast<int>(i));
+            dq_std.push_back(static_cast<int>(i));
+        }
+
+        middleEdits(runner, "bulk/middle_edit/deque", size, [&dq](size_t insert_at, size_t erase_at) {
+            dq.insert(dq.cbegin() + insert_at, static_cast<int>(insert_at));
+            dq.erase(dq.cbegin() + erase_at);
+        });
+
+        middleEdits(runner, "bulk/middle_edit/std_deque", size, [&dq_std](size_t insert_at, size_t erase_at) {
+            dq_std.insert(dq_std.cbegin() + insert_at, static_cast<int>(insert_at));
+            dq_std.erase(dq_std.cbegin() + erase_at);
+        });
+
+        middleEdits(runner, "bulk/middle_edit/vector_rebuild", size, [&dq](size_t insert_at, size_t erase_at) {
+            std::vector <int> items(dq.begin(), dq.end());
+            items.insert(items.begin() + insert_at, static_cast<int>(insert_at));
+            items.erase(items.begin() + erase_at);
+            dq.clear();
+            dq.append(items.begin(), items.end());
+        });
+    }
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark.h"
+#include "concurrent_bag.h"
+#include "concurrent_deque.h"
+#include "deque.h"
+
+namespace {
+    const size_t itemsPerProducer = 1 << 18;
+
+    // the baseline: one Deque behind one mutex
+    class MutexDeque {
+    private:
+        std::mutex mutex_;
+        Deque::Deque <size_t> deque_;
+
+    public:
+        bool tryPush(size_t value) {
+            std::lock_guard <std::mutex> lock(mutex_);
+            deque_.push_back(value);
+            return true;
+        }
+
+        bool tryPop(size_t &value) {
+            std::lock_guard <std::mutex> lock(mutex_);
+
+            if (deque_.empty())
+                return false;
+
+            value = deque_.front();
+            deque_.pop_front();
+            return true;
+        }
+    };
+
+    class TwoLockDeque {
+    private:
+        Deque::ConcurrentDeque <size_t> deque_;
+
+    public:
+        bool tryPush(size_t value) {
+            return deque_.try_push_back(value);
+        }
+
+        bool tryPop(size_t &value) {
+            return deque_.try_pop_front(value);
+        }
+    };
+
+    class LanedBag {
+    private:
+        Deque::ConcurrentBag <size_t> bag_;
+
+    public:
+        bool tryPush(size_t value) {
+            return bag_.try_push(value);
+        }
+
+        bool tryPop(size_t &value) {
+            return bag_.try_pop(value);
+        }
+    };
+
+    // `threads` producers and `threads` consumers move itemsPerProducer items each through the queue
+    template <typename Queue>
+    void producersConsumers(DequeBenchmark::Runner &runner, const std::string &name) {
+        for (size_t threads : DequeBenchmark::threadCounts()) {
+            std::string full = name + "/" + std::to_string(threads) + "x" + std::to_string(threads);
+            size_t total = threads * itemsPerProducer;
+
+            runner.run(full, total, [threads, total] {
+                Queue queue;
+                std::atomic <size_t> consumed{0};
+                std::vector <std::thread> workers;
+
+                for (size_t t = 0; t < threads; ++t) {
+                    workers.emplace_back([&queue] {
+                        for (size_t i = 0; i < itemsPerProducer; ++i)
+                            queue.tryPush(i);
+                    });
+
+                    workers.emplace_back([&queue, &consumed, total] {
+                        size_t value;
+
+                        while (consumed.load(std::memory_order_relaxed) < total)
+                            if (queue.tryPop(value))
+                                consumed.fetch_add(1, std::memory_order_relaxed);
+                            else
+                                std::this_thread::yield();
+                    });
+                }
+
+                for (std::thread &worker : workers)
+                    worker.join();
+            });
+        }
+    }
+}
+
+DEQUE_BENCHMARK(ConcurrentMutexDeque) {
+    producersConsumers <MutexDeque>(runner, "concurrent/mutex_deque");
+}
+
+DEQUE_BENCHMARK(ConcurrentTwoLockDeque) {
+    producersConsumers <TwoLockDeque>(runner, "concurrent/concurrent_deque");
+}
+
+DEQUE_BENCHMARK(ConcurrentLanedBag) {
+    producersConsumers <LanedBag>(runner, "concurrent/concurrent_bag");
+}
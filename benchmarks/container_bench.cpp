@@ -0,0 +1,279 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "deque.h"
+
+// The basic operations of Deque next to std::deque and std::vector, for several element types and sizes:
+// throughput of pushes and pops at both ends, a FIFO in steady state, random access, iteration and copy,
+// and the per-operation latency of pushes and pops, whose tail shows the cost of growing the storage.
+// Each latency sample times a single operation, so it includes the cost of reading the clock.
+namespace {
+    const size_t containerSizes[] = {1000, 100000, 1000000};
+    const size_t latencySize = 1000000;
+
+    struct Payload {
+        std::uint64_t words[8];
+    };
+
+    template <typename T>
+    T makeValue(size_t i);
+
+    template <>
+    int makeValue <int>(size_t i) {
+        return static_cast<int>(i);
+    }
+
+    template <>
+    std::string makeValue <std::string>(size_t i) {
+        return std::string(32, static_cast<char>('a' + i % 26));
+    }
+
+    template <>
+    Payload makeValue <Payload>(size_t i) {
+        Payload payload = {};
+        payload.words[0] = i;
+        return payload;
+    }
+
+    size_t key(int value) {
+        return static_cast<size_t>(value);
+    }
+
+    size_t key(const std::string &value) {
+        return value[0];
+    }
+
+    size_t key(const Payload &value) {
+        return value.words[0];
+    }
+
+    // which operations a container has; std::vector has no cheap front
+    template <typename Container>
+    struct Traits {
+        static constexpr bool kFront = true;
+    };
+
+    template <typename T>
+    struct Traits <std::vector <T>> {
+        static constexpr bool kFront = false;
+    };
+
+    template <typename Container>
+    Container filled(size_t elements) {
+        Container container;
+
+        for (size_t i = 0; i < elements; ++i)
+            container.push_back(makeValue <typename Container::value_type>(i));
+
+        return container;
+    }
+
+    // like Runner::run, but the body times the part it wants measured itself, so refilling is left out
+    template <typename Body>
+    void runMeasured(DequeBenchmark::Runner &runner, const std::string &name, size_t operations, Body body) {
+        if (!runner.selected(name))
+            return;
+
+        size_t calls = 0;
+        double elapsed = 0;
+
+        while (elapsed < DequeBenchmark::minimalTime) {
+            elapsed += body();
+            ++calls;
+        }
+
+        runner.report(name, static_cast<double>(calls) * operations, elapsed);
+    }
+
+    template <typename Operation>
+    double seconds(Operation operation) {
+        DequeBenchmark::Clock::time_point start = DequeBenchmark::Clock::now();
+        operation();
+        return std::chrono::duration <double>(DequeBenchmark::Clock::now() - start).count();
+    }
+
+    template <typename Container>
+    void throughput(DequeBenchmark::Runner &runner, const std::string &prefix, size_t elements) {
+        typedef typename Container::value_type T;
+
+        std::string suffix = "/" + std::to_string(elements);
+
+        runner.run(prefix + "/push_back" + suffix, elements, [elements] {
+            Container container;
+
+            for (size_t i = 0; i < elements; ++i)
+                container.push_back(makeValue <T>(i));
+
+            DequeBenchmark::doNotOptimize(container);
+        });
+
+        runMeasured(runner, prefix + "/pop_back" + suffix, elements, [elements] {
+            Container container = filled <Container>(elements);
+
+            return seconds([&container] {
+                while (!container.empty())
+                    container.pop_back();
+
+                DequeBenchmark::doNotOptimize(container);
+            });
+        });
+
+        if constexpr (Traits <Container>::kFront) {
+            runner.run(prefix + "/push_front" + suffix, elements, [elements] {
+                Container container;
+
+                for (size_t i = 0; i < elements; ++i)
+                    container.push_front(makeValue <T>(i));
+
+                DequeBenchmark::doNotOptimize(container);
+            });
+
+            runMeasured(runner, prefix + "/pop_front" + suffix, elements, [elements] {
+                Container container = filled <Container>(elements);
+
+                return seconds([&container] {
+                    while (!container.empty())
+                        container.pop_front();
+
+                    DequeBenchmark::doNotOptimize(container);
+                });
+            });
+
+            Container queue = filled <Container>(elements);
+            T value = makeValue <T>(elements);
+
+            runner.run(prefix + "/fifo" + suffix, elements, [&queue, &value, elements] {
+                for (size_t i = 0; i < elements; ++i) {
+                    queue.push_back(value);
+                    queue.pop_front();
+                }
+
+                DequeBenchmark::doNotOptimize(queue);
+            });
+        }
+
+        Container container = filled <Container>(elements);
+        std::mt19937 random(7);
+        std::vector <size_t> indices(elements);
+
+        for (size_t &index : indices)
+            index = random() % elements;
+
+        runner.run(prefix + "/random_access" + suffix, elements, [&container, &indices] {
+            size_t total = 0;
+
+            for (size_t index : indices)
+                total += key(container[index]);
+
+            DequeBenchmark::doNotOptimize(total);
+        });
+
+        runner.run(prefix + "/iterate" + suffix, elements, [&container] {
+            size_t total = 0;
+
+            for (const T &value : container)
+                total += key(value);
+
+            DequeBenchmark::doNotOptimize(total);
+        });
+
+        runner.run(prefix + "/copy" + suffix, elements, [&container] {
+            Container copy(container);
+            DequeBenchmark::doNotOptimize(copy);
+        });
+    }
+
+    template <typename Container>
+    void latency(DequeBenchmark::Runner &runner, const std::string &prefix) {
+        typedef typename Container::value_type T;
+
+        std::vector <double> samples(latencySize);
+
+        auto sample = [&runner, &samples](const std::string &name, auto operation) {
+            if (!runner.selected(name))
+                return;
+
+            for (size_t i = 0; i < latencySize; ++i) {
+                DequeBenchmark::Clock::time_point start = DequeBenchmark::Clock::now();
+                operation(i);
+                samples[i] = std::chrono::duration <double, std::nano>(DequeBenchmark::Clock::now() - start).count();
+            }
+
+            runner.reportLatency(name, samples);
+        };
+
+        std::string suffix = "/" + std::to_string(latencySize);
+        Container container;
+
+        sample(prefix + "/push_back_latency" + suffix, [&container](size_t i) {
+            container.push_back(makeValue <T>(i));
+        });
+
+        container = filled <Container>(latencySize);
+
+        sample(prefix + "/pop_back_latency" + suffix, [&container](size_t) {
+            container.pop_back();
+        });
+
+        if constexpr (Traits <Container>::kFront) {
+            container = Container();
+
+            sample(prefix + "/push_front_latency" + suffix, [&container](size_t i) {
+                container.push_front(makeValue <T>(i));
+            });
+
+            container = filled <Container>(latencySize);
+
+            sample(prefix + "/pop_front_latency" + suffix, [&container](size_t) {
+                container.pop_front();
+            });
+        }
+    }
+
+    template <typename Container>
+    void measure(DequeBenchmark::Runner &runner, const std::string &prefix) {
+        for (size_t elements : containerSizes)
+            throughput <Container>(runner, prefix, elements);
+
+        latency <Container>(runner, prefix);
+    }
+
+    template <typename T>
+    void compare(DequeBenchmark::Runner &runner, const std::string &type) {
+        measure <Deque::Deque <T>>(runner, "container/" + type + "/deque");
+        measure <std::deque <T>>(runner, "container/" + type + "/std_deque");
+        measure <std::vector <T>>(runner, "container/" + type + "/vector");
+    }
+}
+
+DEQUE_BENCHMARK(ContainerInt) {
+    compare <int>(runner, "int");
+}
+
+DEQUE_BENCHMARK(ContainerString) {
+    compare <std::string>(runner, "string");
+}
+
+DEQUE_BENCHMARK(ContainerPayload) {
+    compare <Payload>(runner, "payload64");
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#include <deque>
+#include <string>
+
+#include "benchmark.h"
+#include "deque.h"
+
+namespace {
+    const size_t fifoSizes[] = {1000, 1000000, 100000000};
+    const size_t fifoBatch = 1000;
+
+    // the queue holds `elements` items, every operation is a push_back followed by a pop_front
+    template <typename DequeType>
+    void steadyFifo(DequeBenchmark::Runner &runner, const std::string &name) {
+        for (size_t elements : fifoSizes) {
+            DequeType dq;
+
+            for (size_t i = 0; i < elements; ++i)
+                dq.push_back(static_cast<int>(i));
+
+            runner.run(name + "/" + std::to_string(elements), fifoBatch, [&dq] {
+                for (size_t i = 0; i < fifoBatch; ++i) {
+                    dq.push_back(static_cast<int>(i));
+                    dq.pop_front();
+                }
+
+                DequeBenchmark::doNotOptimize(dq);
+            });
+        }
+    }
+}
+
+DEQUE_BENCHMARK(FifoDeque) {
+    steadyFifo <Deque::Deque <int>>(runner, "fifo/deque");
+}
+
+DEQUE_BENCHMARK(FifoStdDeque) {
+    steadyFifo <std::deque <int>>(runner, "fifo/std_deque");
+}
+
+// the cost of CollectStats on the hot path
+DEQUE_BENCHMARK(FifoDequeStats) {
+    steadyFifo <Deque::Deque <int, std::allocator <int>, Deque::DefaultGrowthPolicy, DEQUE_CHECKING_POLICY,
+                              Deque::CollectStats>>(runner, "fifo/deque_stats");
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <deque>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "deque.h"
+
+namespace {
+    const size_t iterationElements = 1 << 20;
+
+    template <typename Container>
+    Container filled() {
+        Container container;
+
+        for (size_t i = 0; i < iterationElements; ++i)
+            container.push_back(static_cast<int>(i * 2654435761u));
+
+        return container;
+    }
+
+    template <typename Container>
+    void iterate(DequeBenchmark::Runner &runner, const std::string &name) {
+        Container container = filled <Container>();
+
+        runner.run("iteration/accumulate/" + name, iterationElements, [&container] {
+            DequeBenchmark::doNotOptimize(std::accumulate(container.begin(), container.end(), 0LL));
+        });
+
+        runner.run("iteration/range_for/" + name, iterationElements, [&container] {
+            for (int &value : container)
+                ++value;
+
+            DequeBenchmark::doNotOptimize(container);
+        });
+
+        runner.run("iteration/reverse/" + name, iterationElements, [&container] {
+            DequeBenchmark::doNotOptimize(std::accumulate(container.rbegin(), container.rend(), 0LL));
+        });
+
+        runner.run("iteration/sort/" + name, iterationElements, [&container] {
+            Container copy = container;
+
+            std::sort(copy.begin(), copy.end());
+            DequeBenchmark::doNotOptimize(copy);
+        });
+    }
+}
+
+DEQUE_BENCHMARK(IterationDeque) {
+    iterate <Deque::Deque <int>>(runner, "deque");
+}
+
+DEQUE_BENCHMARK(IterationStdDeque) {
+    iterate <std::deque <int>>(runner, "std_deque");
+}
+
+DEQUE_BENCHMARK(IterationVector) {
+    iterate <std::vector <int>>(runner, "vector");
+}
+
+// the block-at-a-time loop over readable_spans, which the compiler can vectorize
+DEQUE_BENCHMARK(IterationDequeSpans) {
+    Deque::Deque <int> container = filled <Deque::Deque <int>>();
+
+    runner.run("iteration/accumulate/deque_spans", iterationElements, [&container] {
+        Deque::Span <const int> spans[16];
+        long long sum = 0;
+
+        for (size_t offset = 0; offset < container.size();) {
+            size_t count = container.readable_spans(spans, 16, offset);
+
+            for (size_t i = 0; i < count; ++i) {
+                sum = std::accumulate(spans[i].begin(), spans[i].end(), sum);
+                offset += spans[i].size;
+            }
+        }
+
+        DequeBenchmark::doNotOptimize(sum);
+    });
+}
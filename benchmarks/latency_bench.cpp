@@ -0,0 +1,67 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "deque.h"
+
+namespace {
+    const size_t latencyElements = 10000000;
+
+    // Times every push_back while a deque grows to latencyElements, then every pop_front while it drains.
+    // The tail of the pushes holds the map resizes, which IncrementalGrowthPolicy spreads over later
+    // operations; each sample includes the cost of reading the clock.
+    template <typename Container>
+    void growAndDrain(DequeBenchmark::Runner &runner, const std::string &name) {
+        if (!runner.selected(name))
+            return;
+
+        std::vector <double> samples(latencyElements);
+        Container container;
+
+        for (size_t i = 0; i < latencyElements; ++i) {
+            DequeBenchmark::Clock::time_point start = DequeBenchmark::Clock::now();
+            container.push_back(static_cast<int>(i));
+            samples[i] = std::chrono::duration <double, std::nano>(DequeBenchmark::Clock::now() - start).count();
+        }
+
+        runner.reportLatency(name + "/push_back", samples);
+
+        for (size_t i = 0; i < latencyElements; ++i) {
+            DequeBenchmark::Clock::time_point start = DequeBenchmark::Clock::now();
+            container.pop_front();
+            samples[i] = std::chrono::duration <double, std::nano>(DequeBenchmark::Clock::now() - start).count();
+        }
+
+        runner.reportLatency(name + "/pop_front", samples);
+    }
+}
+
+DEQUE_BENCHMARK(LatencyDeque) {
+    growAndDrain <Deque::Deque <int>>(runner, "latency/deque");
+}
+
+DEQUE_BENCHMARK(LatencyIncrementalDeque) {
+    growAndDrain <Deque::Deque <int, std::allocator <int>, Deque::IncrementalGrowthPolicy>>(runner,
+                                                                                            "latency/incremental");
+}
+
+DEQUE_BENCHMARK(LatencyStdDeque) {
+    growAndDrain <std::deque <int>>(runner, "latency/std_deque");
+}
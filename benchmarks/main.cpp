@@ -0,0 +1,53 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "benchmark.h"
+
+// usage: deque_bench [substring of benchmark names to run] [--json=<file>]
+// the results are always printed; --json also writes them to the file ("-" for stdout, after the table)
+int main(int argc, char **argv) {
+    std::string filter, json;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--json=", 7) == 0)
+            json = argv[i] + 7;
+        else
+            filter = argv[i];
+    }
+
+    DequeBenchmark::Runner runner(filter);
+
+    for (auto &benchmark : DequeBenchmark::registry())
+        benchmark.second(runner);
+
+    if (json.empty())
+        return 0;
+
+    std::FILE *file = json == "-" ? stdout : std::fopen(json.c_str(), "w");
+
+    if (!file) {
+        std::perror(json.c_str());
+        return 1;
+    }
+
+    runner.writeJson(file);
+
+    return file == stdout || std::fclose(file) == 0 ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <string>
+
+#include "benchmark.h"
+#include "deque.h"
+#include "parallel_algorithm.h"
+
+namespace {
+    const size_t parallelElements = 1 << 22;
+
+    Deque::Deque <int> shuffled() {
+        std::mt19937 random(17);
+        Deque::Deque <int> dq;
+
+        for (size_t i = 0; i < parallelElements; ++i)
+            dq.push_back(static_cast<int>(random()));
+
+        return dq;
+    }
+}
+
+// the sequential loops the parallel algorithms replace
+DEQUE_BENCHMARK(ParallelSequentialBaseline) {
+    Deque::Deque <int> dq = shuffled();
+    Deque::Deque <double> roots;
+
+    roots.append(dq.begin(), dq.end());
+
+    runner.run("parallel/transform/sequential", parallelElements, [&dq, &roots] {
+        std::transform(dq.begin(), dq.end(), roots.begin(), [](int value) { return std::sqrt(double(value)); });
+    });
+
+    runner.run("parallel/reduce/sequential", parallelElements, [&dq] {
+        DequeBenchmark::doNotOptimize(std::accumulate(dq.begin(), dq.end(), 0LL));
+    });
+
+    runner.run("parallel/sort/sequential", parallelElements, [&dq] {
+        Deque::Deque <int> copy = dq;
+        std::sort(copy.begin(), copy.end());
+        DequeBenchmark::doNotOptimize(copy);
+    });
+}
+
+DEQUE_BENCHMARK(ParallelScaling) {
+    Deque::Deque <int> dq = shuffled();
+    Deque::Deque <double> roots;
+
+    roots.append(dq.begin(), dq.end());
+
+    for (size_t workers : DequeBenchmark::threadCounts()) {
+        std::string suffix = "/" + std::to_string(workers) + "_threads";
+        Deque::ThreadPool pool(workers);
+
+        runner.run("parallel/for_each" + suffix, parallelElements, [&pool, &dq] {
+            Deque::parallel_for_each(pool, dq, [](int &value) { value ^= 1; });
+        });
+
+        runner.run("parallel/transform" + suffix, parallelElements, [&pool, &dq, &roots] {
+            Deque::parallel_transform(pool, dq, roots, [](int value) { return std::sqrt(double(value)); });
+        });
+
+        runner.run("parallel/reduce" + suffix, parallelElements, [&pool, &dq] {
+            DequeBenchmark::doNotOptimize(Deque::parallel_reduce(pool, dq, 0LL, std::plus <long long>()));
+        });
+
+        runner.run("parallel/sort" + suffix, parallelElements, [&pool, &dq] {
+            Deque::Deque <int> copy = dq;
+            Deque::parallel_sort(pool, copy);
+            DequeBenchmark::doNotOptimize(copy);
+        });
+    }
+}
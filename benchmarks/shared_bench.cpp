@@ -0,0 +1,105 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#include <memory>
+#include <random>
+#include <string>
+
+#include "benchmark.h"
+#include "deque.h"
+#include "shared_deque.h"
+
+namespace {
+    size_t liveBytes = 0;
+
+    // std::allocator that tracks the bytes it has handed out
+    template <typename T>
+    struct TrackingAllocator : std::allocator <T> {
+        typedef T value_type;
+
+        template <typename U>
+        struct rebind {
+            typedef TrackingAllocator <U> other;
+        };
+
+        TrackingAllocator() = default;
+
+        template <typename U>
+        TrackingAllocator(const TrackingAllocator <U> &) {}
+
+        T *allocate(size_t n) {
+            liveBytes += n * sizeof(T);
+            return std::allocator <T>::allocate(n);
+        }
+
+        void deallocate(T *p, size_t n) {
+            liveBytes -= n * sizeof(T);
+            std::allocator <T>::deallocate(p, n);
+        }
+    };
+
+    const size_t snapshotSizes[] = {1000, 1000000};
+    const size_t writesAfterSnapshot = 100;
+
+    // takes a snapshot of a deque holding `elements` ints, then writes to writesAfterSnapshot random elements
+    // of the original; reports the time of both steps and the memory the snapshot costs in the end
+    template <typename DequeType>
+    void snapshotAndWrite(DequeBenchmark::Runner &runner, const std::string &name) {
+        for (size_t elements : snapshotSizes) {
+            std::string suffix = "/" + std::to_string(elements);
+
+            if (!runner.selected(name + suffix))
+                continue;
+
+            DequeType dq;
+
+            for (size_t i = 0; i < elements; ++i)
+                dq.push_back(static_cast<int>(i));
+
+            runner.run(name + "/snapshot" + suffix, 1, [&dq] {
+                DequeType snapshot(dq);
+                DequeBenchmark::doNotOptimize(snapshot);
+            });
+
+            std::mt19937 random(1);
+
+            runner.run(name + "/snapshot_and_writes" + suffix, 1, [&dq, &random, elements] {
+                DequeType snapshot(dq);
+
+                for (size_t i = 0; i < writesAfterSnapshot; ++i)
+                    dq[random() % elements] = static_cast<int>(i);
+
+                DequeBenchmark::doNotOptimize(snapshot);
+            });
+
+            size_t before = liveBytes;
+            DequeType snapshot(dq);
+
+            for (size_t i = 0; i < writesAfterSnapshot; ++i)
+                dq[random() % elements] = static_cast<int>(i);
+
+            runner.reportCount(name + "/snapshot_memory" + suffix, static_cast<double>(liveBytes - before) / 1024, "KiB");
+        }
+    }
+}
+
+DEQUE_BENCHMARK(SnapshotDequeCopy) {
+    snapshotAndWrite <Deque::Deque <int, TrackingAllocator <int>>>(runner, "snapshot/deque_copy");
+}
+
+DEQUE_BENCHMARK(SnapshotSharedDeque) {
+    snapshotAndWrite <Deque::SharedDeque <int, TrackingAllocator <int>>>(runner, "snapshot/shared_deque");
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "deque.h"
+#include "sliding_window.h"
+
+namespace {
+    const size_t windowSizes[] = {16, 256, 4096};
+    const size_t streamLength = 1 << 16;
+
+    std::vector <int> makeStream() {
+        std::mt19937 random(7);
+        std::vector <int> stream(streamLength);
+
+        for (int &value : stream)
+            value = static_cast<int>(random() % 1000000);
+
+        return stream;
+    }
+
+    // the aggregate of the last `window` items after every item of the stream
+    template <typename Op, typename Result>
+    void windowed(DequeBenchmark::Runner &runner, const std::string &name, const std::vector <int> &stream,
+                  size_t window) {
+        runner.run(name + "/sliding_window/" + std::to_string(window), stream.size(), [&stream, window] {
+            Deque::SlidingWindow <Result, Op> aggregate;
+            Result checksum = 0;
+
+            for (int value : stream) {
+                aggregate.push(value);
+                aggregate.keep_last(window);
+                checksum += aggregate.value();
+            }
+
+            DequeBenchmark::doNotOptimize(checksum);
+        });
+    }
+
+    template <typename Rescan>
+    void rescanned(DequeBenchmark::Runner &runner, const std::string &name, const std::vector <int> &stream,
+                   size_t window, Rescan rescan) {
+        runner.run(name + "/rescan/" + std::to_string(window), stream.size(), [&stream, window, rescan] {
+            std::deque <int> items;
+            long long checksum = 0;
+
+            for (int value : stream) {
+                items.push_back(value);
+
+                if (items.size() > window)
+                    items.pop_front();
+
+                checksum += rescan(items);
+            }
+
+            DequeBenchmark::doNotOptimize(checksum);
+        });
+    }
+}
+
+DEQUE_BENCHMARK(SlidingWindowMin) {
+    std::vector <int> stream = makeStream();
+
+    for (size_t window : windowSizes) {
+        windowed <Deque::MinOf <int>, int>(runner, "window/min", stream, window);
+        rescanned(runner, "window/min", stream, window, [](const std::deque <int> &items) {
+            return *std::min_element(items.begin(), items.end());
+        });
+    }
+}
+
+DEQUE_BENCHMARK(SlidingWindowSum) {
+    std::vector <int> stream = makeStream();
+
+    for (size_t window : windowSizes) {
+        windowed <std::plus <long long>, long long>(runner, "window/sum", stream, window);
+        rescanned(runner, "window/sum", stream, window, [](const std::deque <int> &items) {
+            return std::accumulate(items.begin(), items.end(), 0ll);
+        });
+    }
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "benchmark.h"
+#include "deque.h"
+#include "small_deque.h"
+
+namespace {
+    size_t allocations = 0;
+
+    // std::allocator that counts calls to allocate
+    template <typename T>
+    struct CountingAllocator : std::allocator <T> {
+        typedef T value_type;
+
+        template <typename U>
+        struct rebind {
+            typedef CountingAllocator <U> other;
+        };
+
+        CountingAllocator() = default;
+
+        template <typename U>
+        CountingAllocator(const CountingAllocator <U> &) {}
+
+        T *allocate(size_t n) {
+            ++allocations;
+            return std::allocator <T>::allocate(n);
+        }
+    };
+
+    const size_t smallSizes[] = {4, 8, 16, 64};
+    const size_t smallDeques = 1000;
+
+    // creates, fills, drains and destroys smallDeques deques of `elements` items each
+    template <typename DequeType>
+    void createAndDestroy(DequeBenchmark::Runner &runner, const std::string &name) {
+        for (size_t elements : smallSizes) {
+            std::string full = name + "/" + std::to_string(elements);
+
+            if (!runner.selected(full))
+                continue;
+
+            size_t calls = 0;
+            allocations = 0;
+
+            runner.run(full, smallDeques, [elements, &calls] {
+                for (size_t d = 0; d < smallDeques; ++d) {
+                    DequeType dq;
+
+                    for (size_t i = 0; i < elements; ++i)
+                        dq.push_back(static_cast<int>(i));
+
+                    while (!dq.empty())
+                        dq.pop_front();
+
+                    DequeBenchmark::doNotOptimize(dq);
+                }
+
+                ++calls;
+            });
+
+            runner.reportCount(full, static_cast<double>(allocations) / (calls * smallDeques), "allocations/deque");
+        }
+    }
+}
+
+DEQUE_BENCHMARK(SmallDequeInline16) {
+    createAndDestroy <Deque::SmallDeque <int, 16, CountingAllocator <int>>>(runner, "small/small_deque16");
+}
+
+DEQUE_BENCHMARK(SmallDeque) {
+    createAndDestroy <Deque::Deque <int, CountingAllocator <int>>>(runner, "small/deque");
+}
+
+DEQUE_BENCHMARK(SmallStdDeque) {
+    createAndDestroy <std::deque <int, CountingAllocator <int>>>(runner, "small/std_deque");
+}
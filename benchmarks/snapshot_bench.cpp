@@ -0,0 +1,73 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#include <string>
+
+#include <unistd.h>
+
+#include "benchmark.h"
+#include "deque.h"
+#include "deque_io.h"
+
+namespace {
+    const size_t persistSizes[] = {100000, 10000000};
+
+    // saves a deque of `elements` ints and restores it three ways: adopting the mapping without and with
+    // checksum verification, and pushing the elements back one by one from the same file
+    void persistDeque(DequeBenchmark::Runner &runner, size_t elements) {
+        std::string suffix = "/" + std::to_string(elements);
+        std::string path = "/tmp/deque_snapshot_bench_" + std::to_string(getpid());
+
+        Deque::Deque <int> dq;
+
+        for (size_t i = 0; i < elements; ++i)
+            dq.push_back(static_cast<int>(i));
+
+        runner.run("persist/save" + suffix, elements, [&dq, &path] {
+            Deque::save(path, dq);
+        });
+
+        if (!runner.selected("persist/save" + suffix))
+            Deque::save(path, dq);
+
+        runner.run("persist/load_zero_copy" + suffix, elements, [&path] {
+            Deque::Deque <int> loaded = Deque::load <Deque::Deque <int>>(path, false);
+            DequeBenchmark::doNotOptimize(loaded);
+        });
+
+        runner.run("persist/load_verified" + suffix, elements, [&path] {
+            Deque::Deque <int> loaded = Deque::load <Deque::Deque <int>>(path);
+            DequeBenchmark::doNotOptimize(loaded);
+        });
+
+        runner.run("persist/load_push_back" + suffix, elements, [&path, elements] {
+            Deque::Deque <int> mapped = Deque::load <Deque::Deque <int>>(path, false);
+            Deque::Deque <int> loaded;
+
+            for (size_t i = 0; i < elements; ++i)
+                loaded.push_back(mapped[i]);
+
+            DequeBenchmark::doNotOptimize(loaded);
+        });
+
+        unlink(path.c_str());
+    }
+}
+
+DEQUE_BENCHMARK(Persist) {
+    for (size_t elements : persistSizes)
+        persistDeque(runner, elements);
+}
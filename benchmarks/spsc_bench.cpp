@@ -0,0 +1,190 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "benchmark.h"
+#include "deque.h"
+#include "spsc_queue.h"
+
+namespace {
+    const size_t spscItems = 1 << 22;
+    const size_t spscCapacity = 1 << 12;
+    const size_t spscBatch = 64;
+    const size_t latencyStride = 64;
+
+    typedef long long Stamp;
+
+    Stamp now() {
+        return std::chrono::duration_cast <std::chrono::nanoseconds>(
+                DequeBenchmark::Clock::now().time_since_epoch()).count();
+    }
+
+    // the baseline: the same protocol over a Deque guarded by a mutex
+    class MutexQueue {
+    private:
+        std::mutex mutex_;
+        Deque::Deque <Stamp> deque_;
+
+    public:
+        bool tryPush(Stamp stamp) {
+            std::lock_guard <std::mutex> lock(mutex_);
+            deque_.push_back(stamp);
+            return true;
+        }
+
+        bool tryPop(Stamp &stamp) {
+            std::lock_guard <std::mutex> lock(mutex_);
+
+            if (deque_.empty())
+                return false;
+
+            stamp = deque_.front();
+            deque_.pop_front();
+            return true;
+        }
+    };
+
+    class BoundedQueue {
+    private:
+        Deque::BoundedSpscQueue <Stamp> queue_{spscCapacity};
+
+    public:
+        bool tryPush(Stamp stamp) {
+            return queue_.try_push(stamp);
+        }
+
+        bool tryPop(Stamp &stamp) {
+            return queue_.try_pop(stamp);
+        }
+    };
+
+    class GrowableQueue {
+    private:
+        Deque::SpscQueue <Stamp> queue_;
+
+    public:
+        bool tryPush(Stamp stamp) {
+            queue_.push(stamp);
+            return true;
+        }
+
+        bool tryPop(Stamp &stamp) {
+            return queue_.try_pop(stamp);
+        }
+    };
+
+    // one producer thread stamps every item with the time it was pushed, the consumer records how old
+    // every latencyStride-th item is when it comes out; both sides yield instead of spinning so the
+    // numbers stay meaningful on machines with fewer cores than threads
+    template <typename Queue>
+    void pingThrough(DequeBenchmark::Runner &runner, const std::string &name) {
+        if (!runner.selected(name))
+            return;
+
+        Queue queue;
+        std::vector <double> latencies;
+        latencies.reserve(spscItems / latencyStride);
+
+        DequeBenchmark::Clock::time_point start = DequeBenchmark::Clock::now();
+
+        std::thread producer([&queue] {
+            for (size_t i = 0; i < spscItems; ++i)
+                while (!queue.tryPush(now()))
+                    std::this_thread::yield();
+        });
+
+        for (size_t i = 0; i < spscItems; ++i) {
+            Stamp stamp;
+
+            while (!queue.tryPop(stamp))
+                std::this_thread::yield();
+
+            if (i % latencyStride == 0)
+                latencies.push_back(static_cast<double>(now() - stamp));
+        }
+
+        producer.join();
+
+        runner.report(name, spscItems, std::chrono::duration <double>(DequeBenchmark::Clock::now() - start).count());
+        runner.reportLatency(name + "/latency", latencies);
+    }
+
+    // batched variant: both sides move spscBatch items per publication
+    void pingThroughBatched(DequeBenchmark::Runner &runner, const std::string &name) {
+        if (!runner.selected(name))
+            return;
+
+        Deque::BoundedSpscQueue <Stamp> queue(spscCapacity);
+        DequeBenchmark::Clock::time_point start = DequeBenchmark::Clock::now();
+
+        std::thread producer([&queue] {
+            Stamp batch[spscBatch];
+
+            for (size_t pushed = 0; pushed < spscItems;) {
+                size_t wanted = std::min(spscBatch, spscItems - pushed);
+
+                for (size_t i = 0; i < wanted; ++i)
+                    batch[i] = static_cast<Stamp>(pushed + i);
+
+                size_t done = 0;
+
+                while ((done += queue.try_push_n(batch + done, wanted - done)) < wanted)
+                    std::this_thread::yield();
+
+                pushed += wanted;
+            }
+        });
+
+        Stamp batch[spscBatch];
+        Stamp checksum = 0;
+
+        for (size_t popped = 0; popped < spscItems;) {
+            size_t count = queue.try_pop_n(batch, spscBatch);
+
+            if (!count)
+                std::this_thread::yield();
+
+            for (size_t i = 0; i < count; ++i)
+                checksum += batch[i];
+
+            popped += count;
+        }
+
+        producer.join();
+        DequeBenchmark::doNotOptimize(checksum);
+
+        runner.report(name, spscItems, std::chrono::duration <double>(DequeBenchmark::Clock::now() - start).count());
+    }
+}
+
+DEQUE_BENCHMARK(SpscMutexDeque) {
+    pingThrough <MutexQueue>(runner, "spsc/mutex_deque");
+}
+
+DEQUE_BENCHMARK(SpscBounded) {
+    pingThrough <BoundedQueue>(runner, "spsc/bounded");
+}
+
+DEQUE_BENCHMARK(SpscGrowable) {
+    pingThrough <GrowableQueue>(runner, "spsc/growable");
+}
+
+DEQUE_BENCHMARK(SpscBoundedBatched) {
+    pingThroughBatched(runner, "spsc/bounded_batch" + std::to_string(spscBatch));
+}
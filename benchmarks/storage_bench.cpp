@@ -0,0 +1,73 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#include <string>
+
+#include "benchmark.h"
+#include "deque.h"
+#include "huge_page_resource.h"
+
+namespace {
+    const size_t dequeMegabytes[] = {16, 256};
+    const size_t readsPerCall = 1 << 20;
+
+    // dependent random reads, so each one pays its TLB and cache misses in full
+    template <typename DequeType>
+    void randomAccess(DequeBenchmark::Runner &runner, const std::string &name, DequeType &dq, size_t megabytes) {
+        size_t elements = (megabytes << 20) / sizeof(int);
+
+        if (!runner.selected(name))
+            return;
+
+        for (size_t i = 0; i < elements; ++i)
+            dq.push_back(static_cast<int>(i * 2654435761u));
+
+        runner.run(name, readsPerCall, [&dq, elements] {
+            unsigned long long state = 88172645463325252ull;
+            unsigned sum = 0;
+
+            for (size_t i = 0; i < readsPerCall; ++i) {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                sum += static_cast<unsigned>(dq[(state + sum) % elements]);
+            }
+
+            DequeBenchmark::doNotOptimize(sum);
+        });
+    }
+}
+
+DEQUE_BENCHMARK(StorageRandomAccess) {
+    for (size_t megabytes : dequeMegabytes) {
+        Deque::Deque <int> dq;
+        randomAccess(runner, "storage/random_access/default/" + std::to_string(megabytes) + "MiB", dq, megabytes);
+    }
+}
+
+#ifdef DEQUE_HAS_PMR
+DEQUE_BENCHMARK(StorageRandomAccessHugePages) {
+    for (size_t megabytes : dequeMegabytes) {
+        std::string name = "storage/random_access/huge_pages/" + std::to_string(megabytes) + "MiB";
+        Deque::HugePageResource resource(0);
+        Deque::pmr::Deque <int> dq(&resource);
+        randomAccess(runner, name, dq, megabytes);
+
+        if (runner.selected(name))
+            runner.reportCount(name + "/huge_pages_advised", resource.huge_pages() ? 1 : 0, "bool");
+    }
+}
+#endif
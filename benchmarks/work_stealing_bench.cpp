@@ -0,0 +1,53 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+#include "benchmark.h"
+#include "parallel_algorithm.h"
+
+namespace {
+    const size_t forItems = 1 << 22;
+    const size_t forGrain = 1 << 12;
+}
+
+DEQUE_BENCHMARK(WorkStealingParallelFor) {
+    for (size_t workers : DequeBenchmark::threadCounts()) {
+        std::string name = "work_stealing/parallel_for/" + std::to_string(workers) + "_threads";
+
+        if (!runner.selected(name))
+            continue;
+
+        Deque::ThreadPool pool(workers);
+        std::atomic <std::uint64_t> checksum{0};
+
+        runner.run(name, forItems, [&pool, &checksum] {
+            pool.parallel_for(forItems, forGrain, [&checksum](size_t begin, size_t end) {
+                double sum = 0;
+
+                for (size_t i = begin; i < end; ++i)
+                    sum += std::sqrt(static_cast<double>(i));
+
+                checksum.fetch_add(static_cast<std::uint64_t>(sum), std::memory_order_relaxed);
+            });
+        });
+
+        DequeBenchmark::doNotOptimize(checksum);
+    }
+}
@@ -0,0 +1,247 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#ifndef CONCURRENT_BAG_H
+#define CONCURRENT_BAG_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "deque.h"
+
+// A bag shared by any number of producer and consumer threads. It is split into lanes, each a Deque
+// behind its own mutex, and every thread pushes to the back of its own home lane, so producers on
+// different threads do not contend. Pops start at the home lane and move on to the others, trying the
+// locks without waiting first.
+//
+// The price is ordering: there is no container-wide sequence, only per-producer order. A pop takes the
+// oldest (LaneOrder::FIFO) or the newest (LaneOrder::LIFO) element of whichever lane it picks, so the
+// elements one thread pushes come out of FIFO pops in the order pushed and out of LIFO pops in reverse,
+// even when other threads share its lane; elements of different threads interleave in no particular order.
+// ConcurrentDeque keeps one order across the container instead.
+namespace Deque {
+    namespace detail {
+        // a small per-thread number used to spread threads over lanes
+        inline size_t threadIndex() {
+            static std::atomic <size_t> next{0};
+            thread_local size_t index = next.fetch_add(1, std::memory_order_relaxed);
+
+            return index;
+        }
+    }
+
+    // which end of a lane a pop takes from
+    enum class LaneOrder {
+        FIFO,
+        LIFO
+    };
+
+    template <typename T, typename Allocator = std::allocator <T>>
+    class ConcurrentBag {
+    private:
+        struct alignas(kCacheLineSize) Lane {
+            std::mutex mutex;
+            Deque <T, Allocator> deque;
+
+            explicit Lane(const Allocator &allocator) : deque(allocator) {}
+        };
+
+        Lane *lanes_;
+        size_t lane_mask_;
+        Allocator allocator_;
+
+        alignas(kCacheLineSize) std::atomic <size_t> size_{0};
+        std::atomic <bool> closed_{false};
+
+        // consumers blocked in pop sleep here; producers only take the mutex if someone is waiting
+        alignas(kCacheLineSize) std::atomic <size_t> waiting_{0};
+        std::mutex wait_mutex_;
+        std::condition_variable not_empty_;
+
+        Lane &homeLane() const {
+            return lanes_[detail::threadIndex() & lane_mask_];
+        }
+
+        template <typename... Args>
+        bool tryPush(Args &&... args) {
+            if (closed_.load(std::memory_order_acquire))
+                return false;
+
+            {
+                Lane &lane = homeLane();
+                std::lock_guard <std::mutex> lock(lane.mutex);
+
+                lane.deque.emplace_back(std::forward<Args>(args)...);
+
+                // under the lock, so no pop can take the element and decrement first
+                size_.fetch_add(1, std::memory_order_seq_cst);
+            }
+
+            if (waiting_.load(std::memory_order_seq_cst)) {
+                std::lock_guard <std::mutex> lock(wait_mutex_);
+                not_empty_.notify_one();
+            }
+
+            return true;
+        }
+
+        static void take(Deque <T, Allocator> &deque, T &element, LaneOrder order) {
+            if (order == LaneOrder::LIFO) {
+                element = std::move(deque.back());
+                deque.pop_back();
+            } else {
+                element = std::move(deque.front());
+                deque.pop_front();
+            }
+        }
+
+        bool tryPop(T &element, LaneOrder order) {
+            if (!size_.load(std::memory_order_acquire))
+                return false;
+
+            size_t home = detail::threadIndex();
+
+            // first pass skips lanes another thread is holding, second pass waits for them
+            for (int pass = 0; pass < 2; ++pass)
+                for (size_t i = 0; i <= lane_mask_; ++i) {
+                    Lane &lane = lanes_[(home + i) & lane_mask_];
+                    std::unique_lock <std::mutex> lock(lane.mutex, std::defer_lock);
+
+                    if (pass ? (lock.lock(), true) : lock.try_lock()) {
+                        if (lane.deque.empty())
+                            continue;
+
+                        take(lane.deque, element, order);
+                        lock.unlock();
+                        size_.fetch_sub(1, std::memory_order_release);
+
+                        return true;
+                    }
+                }
+
+            return false;
+        }
+
+        template <typename Rep, typename Period>
+        bool waitPop(T &element, const std::chrono::duration <Rep, Period> &timeout, LaneOrder order) {
+            std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+
+            for (;;) {
+                if (tryPop(element, order))
+                    return true;
+
+                waiting_.fetch_add(1, std::memory_order_seq_cst);
+
+                bool ready;
+
+                {
+                    std::unique_lock <std::mutex> lock(wait_mutex_);
+                    ready = not_empty_.wait_until(lock, deadline, [this] {
+                        return size_.load(std::memory_order_seq_cst) || closed_.load(std::memory_order_seq_cst);
+                    });
+                }
+
+                waiting_.fetch_sub(1, std::memory_order_relaxed);
+
+                if (!ready)
+                    return tryPop(element, order);
+
+                // closed: drain what is left, then report failure
+                if (closed_.load(std::memory_order_acquire) && !size_.load(std::memory_order_acquire))
+                    return false;
+            }
+        }
+
+    public:
+        typedef T value_type;
+
+        // lanes is rounded up to a power of two, by default one lane per hardware thread
+        explicit ConcurrentBag(size_t lanes = std::thread::hardware_concurrency(),
+                                 const Allocator &allocator = Allocator()) :
+                lanes_(nullptr), lane_mask_(0), allocator_(allocator) {
+            while (lane_mask_ + 1 < lanes)
+                lane_mask_ = 2 * lane_mask_ + 1;
+
+            lanes_ = static_cast<Lane *>(::operator new[](sizeof(Lane) * (lane_mask_ + 1),
+                                                          std::align_val_t(alignof(Lane))));
+
+            for (size_t i = 0; i <= lane_mask_; ++i)
+                ::new (static_cast<void *>(lanes_ + i)) Lane(allocator_);
+        }
+
+        ConcurrentBag(const ConcurrentBag &) = delete;
+        ConcurrentBag &operator=(const ConcurrentBag &) = delete;
+
+        ~ConcurrentBag() {
+            for (size_t i = 0; i <= lane_mask_; ++i)
+                lanes_[i].~Lane();
+
+            ::operator delete[](lanes_, std::align_val_t(alignof(Lane)));
+        }
+
+        // the try_* calls never block on an empty bag; pushes fail only once closed
+
+        bool try_push(const T &element) {
+            return tryPush(element);
+        }
+
+        bool try_push(T &&element) {
+            return tryPush(std::move(element));
+        }
+
+        template <typename... Args>
+        bool try_emplace(Args &&... args) {
+            return tryPush(std::forward<Args>(args)...);
+        }
+
+        bool try_pop(T &element, LaneOrder order = LaneOrder::FIFO) {
+            return tryPop(element, order);
+        }
+
+        // wait up to timeout for an element; false on timeout or once the bag is closed and drained
+        template <typename Rep, typename Period>
+        bool pop(T &element, const std::chrono::duration <Rep, Period> &timeout, LaneOrder order = LaneOrder::FIFO) {
+            return waitPop(element, timeout, order);
+        }
+
+        // rejects further pushes and wakes every blocked consumer; elements already in stay poppable
+        void close() {
+            closed_.store(true, std::memory_order_seq_cst);
+
+            std::lock_guard <std::mutex> lock(wait_mutex_);
+            not_empty_.notify_all();
+        }
+
+        bool closed() const {
+            return closed_.load(std::memory_order_acquire);
+        }
+
+        // only exact when no thread is running
+        size_t size_approx() const {
+            return size_.load(std::memory_order_acquire);
+        }
+
+        bool empty() const {
+            return size_approx() == 0;
+        }
+    };
+}
+
+#endif //CONCURRENT_BAG_H
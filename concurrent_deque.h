@@ -0,0 +1,360 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#ifndef CONCURRENT_DEQUE_H
+#define CONCURRENT_DEQUE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include "deque.h"
+
+// A deque shared by any number of producer and consumer threads, with one order across the whole
+// container: pop_front takes the element at the front, whichever thread pushed it, and push_front from
+// one thread comes out of pop_front before an older push_back from another.
+//
+// Elements occupy positions [front, back) of fixed-size blocks, like Deque. Each end has its own mutex
+// guarding its position, so work at the front never waits for work at the back. The ends only meet in
+// the element count: a pop first reserves an element by decrementing it, so pops at both ends of a
+// one-element deque cannot take the same element, and a push counts its element before releasing its
+// end. The block map has a third mutex, taken only when an end crosses into another block.
+namespace Deque {
+    template <typename T, typename Allocator = std::allocator <T>>
+    class ConcurrentDeque {
+    private:
+        static constexpr size_t blockSize() {
+            size_t size = 16;
+
+            while (2 * size * sizeof(T) <= 4096)
+                size *= 2;
+
+            return size;
+        }
+
+        static constexpr size_t kBlockSize = blockSize();
+        static constexpr size_t kBlockMask = kBlockSize - 1;
+        static constexpr size_t kMinMapSize = 8;
+        // positions start in the middle of the size_t range, so block numbers never wrap around
+        static constexpr size_t kOrigin = ~size_t(0) / 2 + 1;
+
+        typedef std::allocator_traits <Allocator> AllocatorTraits;
+        typedef typename AllocatorTraits::template rebind_alloc <T *> MapAllocator;
+        typedef std::allocator_traits <MapAllocator> MapAllocatorTraits;
+
+        // the block an end last touched; both fields change only with the end's mutex and map_mutex_ held
+        struct alignas(kCacheLineSize) End {
+            std::mutex mutex;
+            size_t position = kOrigin;
+            size_t number = kOrigin / kBlockSize;
+            T *block = nullptr;
+        };
+
+        Allocator allocator_;
+
+        End front_;
+        End back_;
+
+        // elements pushed and not yet reserved by a pop
+        alignas(kCacheLineSize) std::atomic <size_t> size_{0};
+        std::atomic <bool> closed_{false};
+
+        // A ring of map_size_ block pointers, block number b in map_[b & (map_size_ - 1)]. Every allocated
+        // block lies between the two ends' blocks: front_.position is never below the front block and
+        // back_.position never past the back block, so a block outside them holds no element and is freed
+        // as soon as neither end has it.
+        alignas(kCacheLineSize) std::mutex map_mutex_;
+        T **map_;
+        size_t map_size_;
+        T *spare_;
+
+        // consumers blocked in pop_* sleep here; producers only take the mutex if someone is waiting
+        alignas(kCacheLineSize) std::atomic <size_t> waiting_{0};
+        std::mutex wait_mutex_;
+        std::condition_variable not_empty_;
+
+        T *&mapSlot(size_t number) {
+            return map_[number & (map_size_ - 1)];
+        }
+
+        // re-indexes the ring so that the blocks from `low` to `high` fit
+        void growMap(size_t low, size_t high) {
+            size_t old_low = std::min(front_.number, back_.number);
+            size_t old_high = std::max(front_.number, back_.number);
+            size_t new_size = map_size_;
+
+            while (new_size <= high - low)
+                new_size *= 2;
+
+            if (new_size == map_size_)
+                return;
+
+            MapAllocator allocator(allocator_);
+            T **map = MapAllocatorTraits::allocate(allocator, new_size);
+
+            std::fill(map, map + new_size, nullptr);
+
+            for (size_t number = old_low; number <= old_high; ++number)
+                map[number & (new_size - 1)] = mapSlot(number);
+
+            MapAllocatorTraits::deallocate(allocator, map_, map_size_);
+            map_ = map;
+            map_size_ = new_size;
+        }
+
+        void freeBlock(size_t number) {
+            T *&block = mapSlot(number);
+
+            if (spare_)
+                AllocatorTraits::deallocate(allocator_, block, kBlockSize);
+            else
+                spare_ = block;
+
+            block = nullptr;
+        }
+
+        // with end.mutex held: the slot for `position`, moving the end onto its block if it lies elsewhere
+        T *slot(End &end, size_t position) {
+            size_t number = position / kBlockSize;
+
+            if (number != end.number) {
+                std::lock_guard <std::mutex> lock(map_mutex_);
+
+                growMap(std::min({number, front_.number, back_.number}),
+                        std::max({number, front_.number, back_.number}));
+
+                T *&block = mapSlot(number);
+
+                if (!block) {
+                    block = spare_ ? spare_ : AllocatorTraits::allocate(allocator_, kBlockSize);
+                    spare_ = nullptr;
+                }
+
+                size_t left = end.number;
+
+                end.number = number;
+                end.block = block;
+
+                if ((left < front_.number || left > back_.number) && left != front_.number && left != back_.number)
+                    freeBlock(left);
+            }
+
+            return end.block + (position & kBlockMask);
+        }
+
+        void notifyPush() {
+            if (waiting_.load(std::memory_order_seq_cst)) {
+                std::lock_guard <std::mutex> lock(wait_mutex_);
+                not_empty_.notify_one();
+            }
+        }
+
+        template <bool kBack, typename... Args>
+        bool tryPush(Args &&... args) {
+            if (closed_.load(std::memory_order_acquire))
+                return false;
+
+            {
+                End &end = kBack ? back_ : front_;
+                std::lock_guard <std::mutex> lock(end.mutex);
+                size_t position = kBack ? end.position : end.position - 1;
+
+                AllocatorTraits::construct(allocator_, slot(end, position), std::forward<Args>(args)...);
+                end.position = kBack ? position + 1 : position;
+
+                // under the lock, so a pop at this end cannot see the position before the element is counted
+                size_.fetch_add(1, std::memory_order_seq_cst);
+            }
+
+            notifyPush();
+            return true;
+        }
+
+        // reserves an element for a pop at either end
+        bool reserve() {
+            size_t size = size_.load(std::memory_order_acquire);
+
+            do {
+                if (!size)
+                    return false;
+            } while (!size_.compare_exchange_weak(size, size - 1, std::memory_order_acquire,
+                                                  std::memory_order_acquire));
+
+            return true;
+        }
+
+        template <bool kBack>
+        bool tryPop(T &element) {
+            if (!reserve())
+                return false;
+
+            End &end = kBack ? back_ : front_;
+            std::lock_guard <std::mutex> lock(end.mutex);
+            size_t position = kBack ? end.position - 1 : end.position;
+            T *source = slot(end, position);
+
+            try {
+                element = std::move(*source);
+            } catch (...) {
+                size_.fetch_add(1, std::memory_order_release);
+                throw;
+            }
+
+            AllocatorTraits::destroy(allocator_, source);
+            end.position = kBack ? position : position + 1;
+
+            return true;
+        }
+
+        template <bool kBack, typename Rep, typename Period>
+        bool pop(T &element, const std::chrono::duration <Rep, Period> &timeout) {
+            std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+
+            for (;;) {
+                if (tryPop <kBack>(element))
+                    return true;
+
+                waiting_.fetch_add(1, std::memory_order_seq_cst);
+
+                bool ready;
+
+                {
+                    std::unique_lock <std::mutex> lock(wait_mutex_);
+                    ready = not_empty_.wait_until(lock, deadline, [this] {
+                        return size_.load(std::memory_order_seq_cst) || closed_.load(std::memory_order_seq_cst);
+                    });
+                }
+
+                waiting_.fetch_sub(1, std::memory_order_relaxed);
+
+                if (!ready)
+                    return tryPop <kBack>(element);
+
+                // closed: drain what is left, then report failure
+                if (closed_.load(std::memory_order_acquire) && !size_.load(std::memory_order_acquire))
+                    return false;
+            }
+        }
+
+    public:
+        typedef T value_type;
+
+        explicit ConcurrentDeque(const Allocator &allocator = Allocator()) :
+                allocator_(allocator), map_(nullptr), map_size_(kMinMapSize), spare_(nullptr) {
+            MapAllocator map_allocator(allocator_);
+
+            map_ = MapAllocatorTraits::allocate(map_allocator, map_size_);
+            std::fill(map_, map_ + map_size_, nullptr);
+
+            try {
+                front_.block = back_.block = mapSlot(front_.number) = AllocatorTraits::allocate(allocator_, kBlockSize);
+            } catch (...) {
+                MapAllocatorTraits::deallocate(map_allocator, map_, map_size_);
+                throw;
+            }
+        }
+
+        ConcurrentDeque(const ConcurrentDeque &) = delete;
+        ConcurrentDeque &operator=(const ConcurrentDeque &) = delete;
+
+        ~ConcurrentDeque() {
+            for (size_t position = front_.position; position != back_.position; ++position)
+                AllocatorTraits::destroy(allocator_, mapSlot(position / kBlockSize) + (position & kBlockMask));
+
+            for (size_t number = std::min(front_.number, back_.number);
+                 number <= std::max(front_.number, back_.number); ++number)
+                if (T *block = mapSlot(number))
+                    AllocatorTraits::deallocate(allocator_, block, kBlockSize);
+
+            if (spare_)
+                AllocatorTraits::deallocate(allocator_, spare_, kBlockSize);
+
+            MapAllocator map_allocator(allocator_);
+            MapAllocatorTraits::deallocate(map_allocator, map_, map_size_);
+        }
+
+        // the push_* and try_pop_* calls never block on an empty deque; pushes fail only once closed
+
+        bool try_push_back(const T &element) {
+            return tryPush <true>(element);
+        }
+
+        bool try_push_back(T &&element) {
+            return tryPush <true>(std::move(element));
+        }
+
+        bool try_push_front(const T &element) {
+            return tryPush <false>(element);
+        }
+
+        bool try_push_front(T &&element) {
+            return tryPush <false>(std::move(element));
+        }
+
+        template <typename... Args>
+        bool try_emplace_back(Args &&... args) {
+            return tryPush <true>(std::forward<Args>(args)...);
+        }
+
+        template <typename... Args>
+        bool try_emplace_front(Args &&... args) {
+            return tryPush <false>(std::forward<Args>(args)...);
+        }
+
+        bool try_pop_front(T &element) {
+            return tryPop <false>(element);
+        }
+
+        bool try_pop_back(T &element) {
+            return tryPop <true>(element);
+        }
+
+        // wait up to timeout for an element; false on timeout or once the deque is closed and drained
+        template <typename Rep, typename Period>
+        bool pop_front(T &element, const std::chrono::duration <Rep, Period> &timeout) {
+            return pop <false>(element, timeout);
+        }
+
+        template <typename Rep, typename Period>
+        bool pop_back(T &element, const std::chrono::duration <Rep, Period> &timeout) {
+            return pop <true>(element, timeout);
+        }
+
+        // rejects further pushes and wakes every blocked consumer; elements already in stay poppable
+        void close() {
+            closed_.store(true, std::memory_order_seq_cst);
+
+            std::lock_guard <std::mutex> lock(wait_mutex_);
+            not_empty_.notify_all();
+        }
+
+        bool closed() const {
+            return closed_.load(std::memory_order_acquire);
+        }
+
+        // only exact when no thread is running
+        size_t size_approx() const {
+            return size_.load(std::memory_order_acquire);
+        }
+
+        bool empty() const {
+            return size_approx() == 0;
+        }
+    };
+}
+
+#endif //CONCURRENT_DEQUE_H
@@ -19,80 +19,739 @@
 #define DEQUE_H
 
 #include <algorithm>
+#include <cassert>
+#include <chrono>
 #include <cstdlib>
-#include <iostream>
+#include <cstring>
 #include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define DEQUE_HAS_PMR 1
+#endif
 
 namespace Deque {
     template <typename DType, typename category, typename value_type, typename difference_type, typename pointer,
               typename reference>
     class DequeIterator;
 
+    template <typename T, size_t N, typename Allocator, typename CheckingPolicy>
+    class SmallDeque;
+
+    struct SnapshotAccess;
+
+    // used to keep data written by different threads on different cache lines
+    constexpr size_t kCacheLineSize = 64;
+
+    // a contiguous run of elements inside a container's storage
     template <typename T>
-    class Deque {
-    private:
-        T *data_;
-        size_t max_size_;
-        size_t l_pointer_;
-        size_t r_pointer_;
-
-        enum class ReallocationType {
-            RT_DECREASE,
-            RT_INCREASE,
-            RT_NONE,
-            RT_STAY
+    struct Span {
+        T *data;
+        size_t size;
+
+        T *begin() const {
+            return data;
+        }
+
+        T *end() const {
+            return data + size;
+        }
+    };
+
+    template <typename Category, typename Value, typename Distance, typename Pointer, typename Reference>
+    struct IteratorBase {
+        typedef Category iterator_category;
+        typedef Value value_type;
+        typedef Distance difference_type;
+        typedef Pointer pointer;
+        typedef Reference reference;
+    };
+
+    struct DefaultGrowthPolicy {
+        // the map of blocks grows by kGrowthFactor (a power of two) when it runs out of slots
+        static constexpr size_t kGrowthFactor = 2;
+        // and shrinks by the same factor once at most 1 / kShrinkThreshold of it holds blocks
+        static constexpr size_t kShrinkThreshold = 8;
+        static constexpr bool kShrink = true;
+        // number of elements the smallest map can address
+        static constexpr size_t kMinCapacity = 0;
+        // empty blocks kept at each end, so push/pop around a block boundary does not hit the allocator
+        static constexpr size_t kSpareBlocks = 1;
+        // 0 resizes the map in one go; otherwise a resize only allocates the new map, and each later push or
+        // pop moves up to kMigrationStep block pointers into it, so no single operation copies the whole map
+        static constexpr size_t kMigrationStep = 0;
+    };
+
+    struct NeverShrinkGrowthPolicy : DefaultGrowthPolicy {
+        static constexpr bool kShrink = false;
+    };
+
+    // bounds the worst case of push and pop at the cost of a second lookup while a resize is in flight
+    struct IncrementalGrowthPolicy : DefaultGrowthPolicy {
+        static constexpr size_t kMigrationStep = 4;
+    };
+
+    // What a container does when a precondition is violated: front()/back()/pop_*() on an empty container,
+    // pop_*_n() or commit_back() past the contents. Like the standard containers, operator[] and iterators are
+    // only range-checked under AssertingChecks, while at() always throws DE_OUT_OF_RANGE.
+    struct ThrowingChecks {
+        static constexpr bool kCheckIndex = false;
+
+        template <typename Error>
+        static void require(bool condition, Error error) {
+            if (!condition)
+                throw error;
+        }
+    };
+
+    // every check, operator[] included, is an assert, so debug builds catch misuse and NDEBUG builds pay nothing
+    struct AssertingChecks {
+        static constexpr bool kCheckIndex = true;
+
+        template <typename Error>
+        static void require(bool condition, Error) {
+            assert(condition && "Deque precondition violated");
+            static_cast<void>(condition);
+        }
+    };
+
+    struct NoChecks {
+        static constexpr bool kCheckIndex = false;
+
+        template <typename Error>
+        static void require(bool, Error) {}
+    };
+
+    // How a deque's map of blocks changes. RT_INCREASE and RT_DECREASE resize it. RT_STAY is a spare block
+    // handed from one end of the ring to the other instead of back to the allocator, which is all that
+    // recentering amounts to in a ring.
+    enum class ReallocationType {
+        RT_DECREASE,
+        RT_INCREASE,
+        RT_NONE,
+        RT_STAY
+    };
+
+    // what a deque counts under CollectStats; pushes, pops and inserts are in elements
+    struct DequeStats {
+        static constexpr size_t kReallocationTypes = 4;
+        static constexpr size_t kDurationBuckets = 32;
+
+        size_t push_front = 0;
+        size_t push_back = 0;
+        size_t pop_front = 0;
+        size_t pop_back = 0;
+        // elements insert() and emplace() put between two others; at either end they count as pushes
+        size_t inserts = 0;
+        // indexed by ReallocationType
+        size_t reallocations[kReallocationTypes] = {};
+        // block pointers copied into a new map, at the resize itself or by the later steps of an incremental one
+        size_t bytes_copied = 0;
+        size_t peak_size = 0;
+        // elements the allocated blocks can hold
+        size_t peak_capacity = 0;
+        // bucket i counts the map reallocations that took [2^i, 2^(i + 1)) ns, bucket 0 the shorter ones too
+        size_t reallocation_ns_histogram[kDurationBuckets] = {};
+
+        size_t reallocation_count(ReallocationType type) const {
+            return reallocations[static_cast<size_t>(type)];
+        }
+    };
+
+    // Whether a deque keeps DequeStats. Without them the hooks compile away and the deque is no larger.
+    struct NoStats {
+        static constexpr bool kEnabled = false;
+    };
+
+    struct CollectStats {
+        static constexpr bool kEnabled = true;
+    };
+
+    namespace detail {
+        // a base class, so that NoStats takes no room
+        template <bool kEnabled>
+        struct StatsStorage {};
+
+        template <>
+        struct StatsStorage <true> {
+            DequeStats stats_;
+        };
+
+        // the map being migrated away from by an incremental resize: block numbers in [migrate_next_,
+        // migrate_end_) still live in old_map_
+        template <typename T, bool kEnabled>
+        struct MigrationStorage {};
+
+        template <typename T>
+        struct MigrationStorage <T, true> {
+            T **old_map_ = nullptr;
+            size_t old_map_size_ = 0;
+            size_t migrate_next_ = 0;
+            size_t migrate_end_ = 0;
         };
+    }
+}
+
+// the checking policy containers get when none is given, e.g. -DDEQUE_CHECKING_POLICY=::Deque::NoChecks
+#ifndef DEQUE_CHECKING_POLICY
+#define DEQUE_CHECKING_POLICY ::Deque::ThrowingChecks
+#endif
+
+// the stats policy deques get when none is given, e.g. -DDEQUE_STATS_POLICY=::Deque::CollectStats
+#ifndef DEQUE_STATS_POLICY
+#define DEQUE_STATS_POLICY ::Deque::NoStats
+#endif
+
+namespace Deque {
+    template <typename T, typename Allocator = std::allocator <T>, typename GrowthPolicy = DefaultGrowthPolicy,
+              typename CheckingPolicy = DEQUE_CHECKING_POLICY, typename StatsPolicy = DEQUE_STATS_POLICY>
+    class Deque : private detail::StatsStorage <StatsPolicy::kEnabled>,
+                  private detail::MigrationStorage <T, GrowthPolicy::kMigrationStep != 0> {
+    private:
+        typedef std::allocator_traits <Allocator> AllocatorTraits;
+        typedef typename AllocatorTraits::template rebind_alloc <T *> MapAllocator;
+        typedef std::allocator_traits <MapAllocator> MapAllocatorTraits;
+
+        static_assert(GrowthPolicy::kGrowthFactor >= 2 &&
+                      (GrowthPolicy::kGrowthFactor & (GrowthPolicy::kGrowthFactor - 1)) == 0,
+                      "the map is a ring indexed by a bitmask, so it has to grow by a power of two");
+        static_assert(GrowthPolicy::kShrinkThreshold > 2 * GrowthPolicy::kGrowthFactor,
+                      "a shrunk map has to be at most half full, otherwise it thrashes between growing and shrinking");
+
+        static constexpr size_t binaryLog(size_t value) {
+            return value > 1 ? 1 + binaryLog(value / 2) : 0;
+        }
+
+        static constexpr size_t ceilPowerOfTwo(size_t value) {
+            return size_t(1) << binaryLog(2 * value - 1);
+        }
+
+        static constexpr size_t kBlockBytes = 4096;
+        static constexpr size_t kBlockShift = sizeof(T) < kBlockBytes / 16 ? binaryLog(kBlockBytes / sizeof(T)) : 4;
+        static constexpr size_t kBlockSize = size_t(1) << kBlockShift;
+        static constexpr size_t kBlockMask = kBlockSize - 1;
+        static constexpr size_t kMinMapSize =
+                ceilPowerOfTwo(std::max <size_t>(8, 2 * ((GrowthPolicy::kMinCapacity + kBlockMask) >> kBlockShift)));
+        // positions start in the middle of the size_t range, so block numbers never wrap around
+        static constexpr size_t kOrigin = ~size_t(0) / 2 + 1;
+        static constexpr bool kIncremental = GrowthPolicy::kMigrationStep != 0;
+
+        Allocator allocator_;
+        // a ring of map_size_ (a power of two) block pointers, block number b lives in map_[b & (map_size_ - 1)]
+        T **map_;
+        size_t map_size_;
+        // blocks [block_begin_, block_end_) are allocated, the elements occupy positions [begin_, begin_ + size_)
+        size_t block_begin_;
+        size_t block_end_;
+        size_t begin_;
+        size_t size_;
+        // storage adopted from outside, e.g. a mapped snapshot: blocks inside it are never deallocated one by
+        // one, the whole region goes to release_adopted_ once the deque stops using it
+        char *adopted_;
+        size_t adopted_bytes_;
+        void (*release_adopted_)(void *, size_t);
+
+        // stats hooks, all empty unless StatsPolicy::kEnabled
+        void notePushes(size_t DequeStats::*end, size_t count) {
+            if constexpr (StatsPolicy::kEnabled) {
+                this->stats_.*end += count;
+                this->stats_.peak_size = std::max(this->stats_.peak_size, size_);
+            }
+        }
+
+        void notePops(size_t DequeStats::*end, size_t count) {
+            if constexpr (StatsPolicy::kEnabled)
+                this->stats_.*end += count;
+        }
+
+        void noteCapacity() {
+            if constexpr (StatsPolicy::kEnabled)
+                this->stats_.peak_capacity = std::max(this->stats_.peak_capacity, allocatedBlocks() << kBlockShift);
+        }
+
+        void noteHandOff() {
+            if constexpr (StatsPolicy::kEnabled)
+                ++this->stats_.reallocations[static_cast<size_t>(ReallocationType::RT_STAY)];
+        }
+
+        void noteReallocation(ReallocationType type, long long nanoseconds) {
+            if constexpr (StatsPolicy::kEnabled) {
+                size_t bucket = 0;
+
+                while (bucket + 1 < DequeStats::kDurationBuckets && (2LL << bucket) <= nanoseconds)
+                    ++bucket;
 
-        void printReallocationType(ReallocationType type) {
-            if (type == ReallocationType::RT_INCREASE) {
-                std::cout << "RT_INCREASE\n";
-            } else if (type == ReallocationType::RT_DECREASE) {
-                std::cout << "RT_DECREASE\n";
-            } else if (type == ReallocationType::RT_STAY) {
-                std::cout << "RT_STAY\n";
-            } else if (type == ReallocationType::RT_NONE) {
-                std::cout << "RT_NONE\n";
+                ++this->stats_.reallocations[static_cast<size_t>(type)];
+                ++this->stats_.reallocation_ns_histogram[bucket];
             }
         }
 
+        void noteCopiedPointers(size_t count) {
+            if constexpr (StatsPolicy::kEnabled)
+                this->stats_.bytes_copied += count * sizeof(T *);
+        }
+
+        size_t allocatedBlocks() const {
+            return block_end_ - block_begin_;
+        }
+
+        size_t frontSpareBlocks() const {
+            return (begin_ >> kBlockShift) - block_begin_;
+        }
+
+        size_t backSpareBlocks() const {
+            return block_end_ - ((begin_ + size_ + kBlockMask) >> kBlockShift);
+        }
+
+        static size_t missingBlocks(size_t elements, size_t room) {
+            return elements > room ? (elements - room + kBlockMask) >> kBlockShift : 0;
+        }
+
+        // elements live in fixed-size blocks and the map is a ring, so the only copy ever made is
+        // that of the block pointers when the map itself changes size
         ReallocationType needReallocation() const {
-            if (4 * size() <= max_size_)
+            if (GrowthPolicy::kShrink && map_size_ > kMinMapSize &&
+                GrowthPolicy::kShrinkThreshold * allocatedBlocks() <= map_size_)
                 return ReallocationType::RT_DECREASE;
-            if (l_pointer_ == static_cast<size_t>(-1) || r_pointer_ == max_size_ - 1) {
-                if (size() < max_size_ / 2)
-                    return ReallocationType::RT_STAY;
-                else
-                    return ReallocationType::RT_INCREASE;
-            }
 
             return ReallocationType::RT_NONE;
         }
 
-        void reallocate(ReallocationType type) {
+        // makes sure the map has slots for `front` more elements before the first one and `back` after the last one
+        void makeRoom(size_t front, size_t back) {
+            size_t needed = allocatedBlocks() + missingBlocks(front, begin_ - (block_begin_ << kBlockShift)) +
+                            missingBlocks(back, (block_end_ << kBlockShift) - begin_ - size_);
+
+            if (needed <= map_size_)
+                return;
+
+            size_t new_map_size = std::max(map_size_, kMinMapSize);
+
+            while (new_map_size < needed)
+                new_map_size *= GrowthPolicy::kGrowthFactor;
+
+            reallocate(ReallocationType::RT_INCREASE, new_map_size);
+        }
+
+        void reallocate(ReallocationType type, size_t new_map_size) {
             if (type == ReallocationType::RT_NONE)
                 return;
 
-            if (max_size_ == 2 && type == ReallocationType::RT_DECREASE)
+            std::chrono::steady_clock::time_point start;
+
+            if constexpr (StatsPolicy::kEnabled)
+                start = std::chrono::steady_clock::now();
+
+            if constexpr (kIncremental) {
+                finishMigration();
+
+                this->old_map_ = allocateMap(new_map_size);
+                this->old_map_size_ = new_map_size;
+                std::swap(map_, this->old_map_);
+                std::swap(map_size_, this->old_map_size_);
+                this->migrate_next_ = block_begin_;
+                this->migrate_end_ = block_end_;
+
+                if (!this->old_map_)
+                    this->migrate_next_ = this->migrate_end_;
+            } else {
+                T **new_map = allocateMap(new_map_size);
+
+                for (size_t i = block_begin_; i != block_end_; ++i)
+                    new_map[i & (new_map_size - 1)] = map_[i & (map_size_ - 1)];
+
+                noteCopiedPointers(allocatedBlocks());
+                deallocateMap();
+                map_ = new_map;
+                map_size_ = new_map_size;
+            }
+
+            if constexpr (StatsPolicy::kEnabled) {
+                noteReallocation(type, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start).count());
+            }
+        }
+
+        // only the slots of allocated blocks are ever read, the incremental mode skips clearing the rest
+        T **allocateMap(size_t size) {
+            MapAllocator allocator(allocator_);
+            T **map = MapAllocatorTraits::allocate(allocator, size);
+
+            if constexpr (!kIncremental)
+                std::fill(map, map + size, nullptr);
+
+            return map;
+        }
+
+        void deallocateMap() {
+            if (!map_)
+                return;
+
+            MapAllocator allocator(allocator_);
+            MapAllocatorTraits::deallocate(allocator, map_, map_size_);
+        }
+
+        // Moves up to `count` block pointers of an incremental resize into the new map and frees the old one
+        // after the last. Block numbers that are not allocated when their turn comes are skipped; if one gets
+        // allocated later it lives in the new map, as every number below migrate_next_ does.
+        void migrateBlocks(size_t count) {
+            if constexpr (kIncremental) {
+                if (!this->old_map_)
+                    return;
+
+                size_t moved = 0;
+
+                for (; count && this->migrate_next_ != this->migrate_end_; --count, ++this->migrate_next_) {
+                    size_t number = this->migrate_next_;
+
+                    if (number - block_begin_ < allocatedBlocks()) {
+                        map_[number & (map_size_ - 1)] = this->old_map_[number & (this->old_map_size_ - 1)];
+                        ++moved;
+                    }
+                }
+
+                noteCopiedPointers(moved);
+
+                if (this->migrate_next_ == this->migrate_end_)
+                    dropOldMap();
+            }
+        }
+
+        void finishMigration() {
+            migrateBlocks(~size_t(0));
+        }
+
+        void dropOldMap() {
+            if constexpr (kIncremental) {
+                if (!this->old_map_)
+                    return;
+
+                MapAllocator allocator(allocator_);
+                MapAllocatorTraits::deallocate(allocator, this->old_map_, this->old_map_size_);
+                this->old_map_ = nullptr;
+                this->old_map_size_ = 0;
+                this->migrate_next_ = this->migrate_end_ = 0;
+            }
+        }
+
+        T *&block(size_t number) const {
+            if constexpr (kIncremental) {
+                if (number - this->migrate_next_ < this->migrate_end_ - this->migrate_next_)
+                    return this->old_map_[number & (this->old_map_size_ - 1)];
+            }
+
+            return map_[number & (map_size_ - 1)];
+        }
+
+        // blocks are raw storage, only the slots in [begin_, begin_ + size_) hold constructed elements
+        T *slot(size_t position) const {
+            return block(position >> kBlockShift) + (position & kBlockMask);
+        }
+
+        void allocateFront(size_t elements) {
+            while (begin_ - (block_begin_ << kBlockShift) < elements) {
+                block(block_begin_ - 1) = AllocatorTraits::allocate(allocator_, kBlockSize);
+                --block_begin_;
+            }
+
+            noteCapacity();
+        }
+
+        void allocateBack(size_t elements) {
+            while ((block_end_ << kBlockShift) - begin_ - size_ < elements) {
+                block(block_end_) = AllocatorTraits::allocate(allocator_, kBlockSize);
+                ++block_end_;
+            }
+
+            noteCapacity();
+        }
+
+        // called when a pop has emptied a block at the front: a surplus spare either moves to the back,
+        // which in the ring is just a change of ownership, or is returned to the allocator
+        void retireFrontBlock() {
+            if (frontSpareBlocks() <= GrowthPolicy::kSpareBlocks)
+                return;
+
+            if (backSpareBlocks() < GrowthPolicy::kSpareBlocks) {
+                block(block_end_++) = block(block_begin_++);
+                noteHandOff();
+            } else {
+                deallocateBlock(block(block_begin_++));
+            }
+        }
+
+        void retireBackBlock() {
+            if (backSpareBlocks() <= GrowthPolicy::kSpareBlocks)
                 return;
 
-            size_t size_ = size();
-            T *copy_ = std::move(data_);
+            if (frontSpareBlocks() < GrowthPolicy::kSpareBlocks) {
+                --block_end_;
+                block(--block_begin_) = block(block_end_);
+                noteHandOff();
+            } else {
+                deallocateBlock(block(--block_end_));
+            }
+        }
+
+        void deallocateBlock(T *&block) {
+            std::less <const char *> less;
+            const char *address = reinterpret_cast<const char *>(block);
+
+            if (!adopted_ || less(address, adopted_) || !less(address, adopted_ + adopted_bytes_))
+                AllocatorTraits::deallocate(allocator_, block, kBlockSize);
+
+            block = nullptr;
+        }
+
+        void releaseAdopted() {
+            if (!adopted_)
+                return;
+
+            release_adopted_(adopted_, adopted_bytes_);
+            adopted_ = nullptr;
+            adopted_bytes_ = 0;
+        }
+
+        // takes over `count` elements laid out block by block from `data`, which lies inside `region`;
+        // the deque has to be empty
+        void adoptBlocks(void *region, size_t region_bytes, void (*release_region)(void *, size_t), T *data,
+                         size_t count) {
+            release();
+            makeRoom(0, count);
+
+            for (size_t i = 0; i < count; i += kBlockSize)
+                block(block_end_++) = data + i;
+
+            size_ = count;
+            noteCapacity();
+            notePushes(&DequeStats::push_back, count);
+            adopted_ = static_cast<char *>(region);
+            adopted_bytes_ = region_bytes;
+            release_adopted_ = release_region;
+        }
+
+        void destroy(size_t position) {
+            AllocatorTraits::destroy(allocator_, slot(position));
+        }
+
+        template <typename Iterator>
+        static constexpr bool isContiguousSource() {
+            return std::is_trivially_copyable <T>::value && std::is_pointer <Iterator>::value &&
+                   std::is_same <typename std::remove_cv <typename std::remove_pointer <Iterator>::type>::type,
+                                 T>::value;
+        }
+
+        // number of slots from position to the end of its block, at most count
+        static size_t runLength(size_t position, size_t count) {
+            return std::min(count, kBlockSize - (position & kBlockMask));
+        }
+
+        template <typename Element>
+        size_t describeRuns(size_t position, size_t count, Span <Element> *spans, size_t max_spans) const {
+            size_t filled = 0;
+
+            for (size_t run; count && filled < max_spans; position += run, count -= run) {
+                run = runLength(position, count);
+                spans[filled++] = Span <Element>{slot(position), run};
+            }
+
+            return filled;
+        }
+
+        // constructs count elements from first in the raw slots starting at position
+        template <typename Iterator>
+        Iterator constructRange(size_t position, Iterator first, size_t count) {
+            if constexpr (isContiguousSource <Iterator>()) {
+                for (size_t done = 0, run; done < count; done += run, first += run) {
+                    run = runLength(position + done, count - done);
+                    std::memcpy(slot(position + done), first, run * sizeof(T));
+                }
+            } else {
+                size_t done = 0;
+
+                try {
+                    for (; done < count; ++done, ++first)
+                        AllocatorTraits::construct(allocator_, slot(position + done), *first);
+                } catch (...) {
+                    destroyRange(position, done);
+                    throw;
+                }
+            }
+
+            return first;
+        }
+
+        // move-constructs count elements starting at from into the raw slots starting at to
+        void constructMoved(size_t to, size_t from, size_t count) {
+            if constexpr (std::is_trivially_copyable <T>::value) {
+                moveElements(from, to, count);
+            } else {
+                size_t done = 0;
+
+                try {
+                    for (; done < count; ++done)
+                        AllocatorTraits::construct(allocator_, slot(to + done),
+                                                   std::move_if_noexcept(*slot(from + done)));
+                } catch (...) {
+                    destroyRange(to, done);
+                    throw;
+                }
+            }
+        }
+
+        template <typename Iterator>
+        void assignRange(size_t position, Iterator first, size_t count) {
+            if constexpr (isContiguousSource <Iterator>()) {
+                for (size_t done = 0, run; done < count; done += run, first += run) {
+                    run = runLength(position + done, count - done);
+                    std::memcpy(slot(position + done), first, run * sizeof(T));
+                }
+            } else {
+                for (size_t done = 0; done < count; ++done, ++first)
+                    *slot(position + done) = *first;
+            }
+        }
+
+        // moves count elements from position from to position to, the ranges may overlap
+        void moveElements(size_t from, size_t to, size_t count) {
+            if constexpr (std::is_trivially_copyable <T>::value) {
+                if (to - from < count) {
+                    for (size_t left = count, run; left; left -= run) {
+                        run = std::min({left, ((from + left - 1) & kBlockMask) + 1, ((to + left - 1) & kBlockMask) + 1});
+                        std::memmove(slot(to + left - run), slot(from + left - run), run * sizeof(T));
+                    }
+                } else {
+                    for (size_t done = 0, run; done < count; done += run) {
+                        run = std::min(runLength(from + done, count - done), runLength(to + done, count - done));
+                        std::memmove(slot(to + done), slot(from + done), run * sizeof(T));
+                    }
+                }
+            } else if (to - from < count) {
+                for (size_t left = count; left; --left)
+                    *slot(to + left - 1) = std::move(*slot(from + left - 1));
+            } else {
+                for (size_t done = 0; done < count; ++done)
+                    *slot(to + done) = std::move(*slot(from + done));
+            }
+        }
+
+        void destroyRange(size_t position, size_t count) {
+            if (!std::is_trivially_destructible <T>::value) {
+                for (size_t i = 0; i < count; ++i)
+                    destroy(position + i);
+            }
+        }
+
+        // final element k lives at begin_ - n + k: slots k < n are raw, the first index elements
+        // move n slots to the front and the items fill [index, index + n)
+        template <typename Iterator>
+        void insertAtFront(size_t index, Iterator first, size_t n) {
+            reserve_front(n);
+
+            size_t old_begin = begin_;
+            size_t new_begin = begin_ - n;
+            size_t raw_items = n > index ? n - index : 0;
+
+            first = constructRange(new_begin + index, first, raw_items);
+
+            try {
+                constructMoved(new_begin, old_begin, std::min(index, n));
+            } catch (...) {
+                destroyRange(new_begin + index, raw_items);
+                throw;
+            }
+
+            begin_ = new_begin;
+            size_ += n;
+
+            if (index > n)
+                moveElements(old_begin + n, old_begin, index - n);
+
+            assignRange(new_begin + std::max(index, n), first, std::min(index, n));
+        }
+
+        // final element k lives at begin_ + k: slots k >= size_ are raw, the elements after index
+        // move n slots to the back and the items fill [index, index + n)
+        template <typename Iterator>
+        void insertAtBack(size_t index, Iterator first, size_t n) {
+            reserve_back(n);
+
+            size_t tail = size_ - index;
+            size_t live_items = std::min(n, tail);
+            size_t moved_begin = begin_ + std::max(size_, index + n);
+
+            Iterator raw_items = first;
+            std::advance(raw_items, live_items);
+            constructRange(begin_ + size_, raw_items, n - live_items);
+
+            try {
+                constructMoved(moved_begin, moved_begin - n, live_items);
+            } catch (...) {
+                destroyRange(begin_ + size_, n - live_items);
+                throw;
+            }
+
+            size_ += n;
+
+            if (tail > n)
+                moveElements(begin_ + index, begin_ + index + n, tail - n);
+
+            assignRange(begin_ + index, first, live_items);
+        }
+
+        void swapStorage(Deque &other) noexcept {
+            std::swap(map_, other.map_);
+            std::swap(map_size_, other.map_size_);
+            std::swap(block_begin_, other.block_begin_);
+            std::swap(block_end_, other.block_end_);
+            std::swap(begin_, other.begin_);
+            std::swap(size_, other.size_);
+            std::swap(adopted_, other.adopted_);
+            std::swap(adopted_bytes_, other.adopted_bytes_);
+            std::swap(release_adopted_, other.release_adopted_);
+
+            if constexpr (kIncremental) {
+                std::swap(this->old_map_, other.old_map_);
+                std::swap(this->old_map_size_, other.old_map_size_);
+                std::swap(this->migrate_next_, other.migrate_next_);
+                std::swap(this->migrate_end_, other.migrate_end_);
+            }
+        }
+
+        void release() {
+            clear();
+            deallocateMap();
+
+            map_ = nullptr;
+            map_size_ = 0;
+        }
+
+        template <typename, typename, typename, typename, typename, typename>
+        friend class DequeIterator;
 
-            data_ = nullptr;
+        template <typename, size_t, typename, typename>
+        friend class SmallDeque;
 
-            if (type == ReallocationType::RT_INCREASE)
-                max_size_ *= 2;
-            if (type == ReallocationType::RT_DECREASE)
-                max_size_ /= 2;
+        friend struct SnapshotAccess;
 
-            data_ = new T[max_size_];
+        // for iterators: the slot of element `index` and the block it lies in, or nulls if that block is not allocated
+        T *iteratorSegment(long long index, T *&first, T *&last) const {
+            size_t position = begin_ + static_cast<size_t>(index);
+            size_t number = position >> kBlockShift;
 
-            std::copy(copy_ + l_pointer_ + 1, copy_ + l_pointer_ + size_ + 1, data_ + max_size_ / 4);
+            if (number - block_begin_ >= allocatedBlocks()) {
+                first = last = nullptr;
+                return nullptr;
+            }
 
-            l_pointer_ = max_size_ / 4 - 1;
-            r_pointer_ = l_pointer_ + size_;
+            first = block(number);
+            last = first + kBlockSize;
 
-            delete[] copy_;
+            return first + (position & kBlockMask);
         }
 
     public:
@@ -100,167 +759,486 @@ namespace Deque {
             DE_EMPTY,
             DE_INTERNAL_ERROR,
             DE_FULL,
-            DE_OUT_OF_RANGE
+            DE_OUT_OF_RANGE,
+            DE_IO_ERROR,
+            DE_BAD_FORMAT
         };
 
-        typedef DequeIterator <Deque <T>, std::random_access_iterator_tag, T, long long, T *, T &> iterator;
-        typedef DequeIterator <const Deque <T>, std::random_access_iterator_tag, T, long long, const T *, const T &>
+        typedef T value_type;
+        typedef Allocator allocator_type;
+        typedef CheckingPolicy checking_policy;
+        typedef StatsPolicy stats_policy;
+        typedef size_t size_type;
+        typedef T &reference;
+        typedef const T &const_reference;
+
+        typedef DequeIterator <Deque, std::random_access_iterator_tag, T, long long, T *, T &> iterator;
+        typedef DequeIterator <const Deque, std::random_access_iterator_tag, T, long long, const T *, const T &>
                 const_iterator;
         typedef std::reverse_iterator <iterator> reverse_iterator;
         typedef std::reverse_iterator <const_iterator> const_reverse_iterator;
 
-        Deque() : max_size_(2),
-                  l_pointer_(0), r_pointer_(0) {
-            data_ = new T[2];
+        Deque() : Deque(Allocator()) {}
 
-            if (!data_)
-                throw Errors::DE_INTERNAL_ERROR;
-        }
+        explicit Deque(const Allocator &allocator) noexcept : allocator_(allocator), map_(nullptr), map_size_(0),
+                                                             block_begin_(kOrigin >> kBlockShift),
+                                                             block_end_(kOrigin >> kBlockShift),
+                                                             begin_(kOrigin), size_(0), adopted_(nullptr),
+                                                             adopted_bytes_(0), release_adopted_(nullptr) {}
 
-        Deque(const Deque <T> &old) : max_size_(old.max_size_),
-                                      l_pointer_(old.l_pointer_), r_pointer_(old.r_pointer_) {
-            data_ = new T[max_size_];
+        Deque(const Deque &old) : Deque(old, AllocatorTraits::select_on_container_copy_construction(old.allocator_)) {}
 
-            if (!data_)
-                throw Errors::DE_INTERNAL_ERROR;
+        Deque(const Deque &old, const Allocator &allocator) : Deque(allocator) {
+            reserve_back(old.size());
 
-            std::copy(old.data_, old.data_ + max_size_, data_);
+            for (size_t i = 0; i < old.size(); ++i)
+                push_back(old[i]);
         }
 
+        Deque(Deque &&old) noexcept : Deque(old.allocator_) {
+            swapStorage(old);
+        }
 
-        Deque(Deque <T> &&old) : max_size_(old.max_size_),
-                                 l_pointer_(old.l_pointer_), r_pointer_(old.r_pointer_),
-                                 data_(std::move(old.data_)) {
-            old.max_size_ = 0;
-            old.l_pointer_ = old.r_pointer_ = 0;
-            old.data_ = nullptr;
+        Deque(Deque &&old, const Allocator &allocator) : Deque(allocator) {
+            if (allocator_ == old.allocator_) {
+                swapStorage(old);
+                return;
+            }
+
+            reserve_back(old.size());
+
+            for (size_t i = 0; i < old.size(); ++i)
+                push_back(std::move(old[i]));
+
+            old.clear();
         }
 
         ~Deque() {
-            delete[] data_;
+            release();
         }
 
-        Deque <T> &operator=(const Deque <T> &right) {
+        Deque &operator=(const Deque &right) {
             if (&right == this)
                 return *this;
 
-            max_size_ = right.max_size_;
-            l_pointer_ = right.l_pointer_;
-            r_pointer_ = right.r_pointer_;
+            if constexpr (AllocatorTraits::propagate_on_container_copy_assignment::value) {
+                if (allocator_ != right.allocator_)
+                    release();
 
-            delete[] data_;
-            data_ = new T[max_size_];
-
-            if (!data_)
-                throw Errors::DE_INTERNAL_ERROR;
+                allocator_ = right.allocator_;
+            }
 
-            for (size_t i = 0; i < max_size_; ++i)
-                data_[i] = right.data_[i];
+            Deque copy(right, allocator_);
+            swapStorage(copy);
 
             return *this;
         }
 
-        Deque <T> &operator=(Deque <T> &&right) {
+        Deque &operator=(Deque &&right) {
             if (&right == this)
                 return *this;
 
-            max_size_ = right.max_size_;
-            l_pointer_ = right.l_pointer_;
-            r_pointer_ = right.r_pointer_;
+            if constexpr (AllocatorTraits::propagate_on_container_move_assignment::value) {
+                release();
+                allocator_ = right.allocator_;
+                swapStorage(right);
+            } else {
+                Deque temp(std::move(right), allocator_);
+                swapStorage(temp);
+            }
+
+            return *this;
+        }
+
+        void swap(Deque &other) {
+            if constexpr (AllocatorTraits::propagate_on_container_swap::value) {
+                using std::swap;
+                swap(allocator_, other.allocator_);
+            }
+
+            swapStorage(other);
+        }
 
-            delete[] data_;
+        allocator_type get_allocator() const {
+            return allocator_;
+        }
 
-            data_ = std::move(right.data_);
-            right.data_ = nullptr;
+        // what happened to this deque since it was created or reset_stats() was called, under CollectStats;
+        // the counters stay with the object, swaps and moves do not exchange them
+        const DequeStats &stats() const {
+            static_assert(StatsPolicy::kEnabled, "stats() needs a deque with CollectStats");
+            return this->stats_;
+        }
 
-            if (!data_)
-                throw Errors::DE_INTERNAL_ERROR;
+        // zeroes the counters, the peaks start again from the current size and capacity
+        void reset_stats() {
+            static_assert(StatsPolicy::kEnabled, "reset_stats() needs a deque with CollectStats");
 
-            return *this;
+            this->stats_ = DequeStats();
+            this->stats_.peak_size = size_;
+            this->stats_.peak_capacity = allocatedBlocks() << kBlockShift;
+        }
+
+        void clear() {
+            if (!std::is_trivially_destructible <T>::value) {
+                for (size_t i = 0; i < size_; ++i)
+                    destroy(begin_ + i);
+            }
+
+            for (size_t i = block_begin_; i != block_end_; ++i)
+                deallocateBlock(block(i));
+
+            dropOldMap();
+            block_begin_ = block_end_ = kOrigin >> kBlockShift;
+            begin_ = kOrigin;
+            size_ = 0;
+            releaseAdopted();
+        }
+
+        // after reserve_front(n) the next n push_front calls do not allocate
+        void reserve_front(size_t elements) {
+            makeRoom(elements, 0);
+            allocateFront(elements);
+        }
+
+        // after reserve_back(n) the next n push_back calls do not allocate
+        void reserve_back(size_t elements) {
+            makeRoom(0, elements);
+            allocateBack(elements);
+        }
+
+        void reserve(size_t elements) {
+            if (elements > size_)
+                reserve_back(elements - size_);
+        }
+
+        void shrink_to_fit() {
+            if (empty()) {
+                release();
+                return;
+            }
+
+            for (; frontSpareBlocks(); ++block_begin_)
+                deallocateBlock(block(block_begin_));
+            for (; backSpareBlocks(); --block_end_)
+                deallocateBlock(block(block_end_ - 1));
+
+            size_t new_map_size = kMinMapSize;
+
+            while (new_map_size < allocatedBlocks())
+                new_map_size *= GrowthPolicy::kGrowthFactor;
+
+            if (new_map_size < map_size_)
+                reallocate(ReallocationType::RT_DECREASE, new_map_size);
         }
 
         inline size_t size() const {
-            return r_pointer_ - l_pointer_;
+            return size_;
         }
 
         bool empty() const {
             return size() == 0;
         }
 
-        void push_back(T element) {
-            reallocate(needReallocation());
+        template <typename... Args>
+        T &emplace_back(Args &&... args) {
+            if (begin_ + size_ == block_end_ << kBlockShift)
+                reserve_back(1);
+
+            size_t position = begin_ + size_;
 
-            if (r_pointer_ + 1 == max_size_)
-                throw Errors::DE_FULL;
+            AllocatorTraits::construct(allocator_, slot(position), std::forward<Args>(args)...);
+            ++size_;
+            notePushes(&DequeStats::push_back, 1);
+            migrateBlocks(GrowthPolicy::kMigrationStep);
 
-            data_[++r_pointer_] = element;
+            return *slot(position);
         }
 
-        void push_front(T element) {
-            reallocate(needReallocation());
+        template <typename... Args>
+        T &emplace_front(Args &&... args) {
+            if (begin_ == block_begin_ << kBlockShift)
+                reserve_front(1);
+
+            size_t position = begin_ - 1;
 
-            if (static_cast<size_t>(l_pointer_ + 1) == 0)
-                throw Errors::DE_FULL;
+            AllocatorTraits::construct(allocator_, slot(position), std::forward<Args>(args)...);
+            begin_ = position;
+            ++size_;
+            notePushes(&DequeStats::push_front, 1);
+            migrateBlocks(GrowthPolicy::kMigrationStep);
 
-            data_[l_pointer_--] = element;
+            return *slot(position);
+        }
+
+        void push_back(const T &element) {
+            emplace_back(element);
+        }
+
+        void push_back(T &&element) {
+            emplace_back(std::move(element));
+        }
+
+        void push_front(const T &element) {
+            emplace_front(element);
+        }
+
+        void push_front(T &&element) {
+            emplace_front(std::move(element));
         }
 
         void pop_front() {
-            if (empty())
-                throw Errors::DE_EMPTY;
+            CheckingPolicy::require(!empty(), Errors::DE_EMPTY);
+
+            destroy(begin_);
+            ++begin_;
+            --size_;
+            notePops(&DequeStats::pop_front, 1);
+            migrateBlocks(GrowthPolicy::kMigrationStep);
+
+            if ((begin_ & kBlockMask) == 0) {
+                retireFrontBlock();
 
-            ++l_pointer_;
-            reallocate(needReallocation());
+                if (needReallocation() == ReallocationType::RT_DECREASE)
+                    reallocate(ReallocationType::RT_DECREASE, map_size_ / GrowthPolicy::kGrowthFactor);
+            }
         }
 
         void pop_back() {
-            if (empty())
-                throw Errors::DE_EMPTY;
+            CheckingPolicy::require(!empty(), Errors::DE_EMPTY);
+
+            --size_;
+            destroy(begin_ + size_);
+            notePops(&DequeStats::pop_back, 1);
+            migrateBlocks(GrowthPolicy::kMigrationStep);
+
+            if (((begin_ + size_) & kBlockMask) == 0) {
+                retireBackBlock();
 
-            --r_pointer_;
-            reallocate(needReallocation());
+                if (needReallocation() == ReallocationType::RT_DECREASE)
+                    reallocate(ReallocationType::RT_DECREASE, map_size_ / GrowthPolicy::kGrowthFactor);
+            }
         }
 
-        T &front() {
-            if (!size())
-                throw Errors::DE_EMPTY;
+        template <typename Iterator>
+        void append(Iterator first, Iterator last) {
+            if constexpr (std::is_base_of <std::forward_iterator_tag,
+                                           typename std::iterator_traits <Iterator>::iterator_category>::value) {
+                size_t n = std::distance(first, last);
+
+                reserve_back(n);
+                constructRange(begin_ + size_, first, n);
+                size_ += n;
+                notePushes(&DequeStats::push_back, n);
+            } else {
+                for (; first != last; ++first)
+                    emplace_back(*first);
+            }
+        }
 
-            return operator[](0);
+        template <typename Iterator>
+        void prepend(Iterator first, Iterator last) {
+            insert(cbegin(), first, last);
         }
 
-        T front() const {
-            if (!size())
-                throw Errors::DE_EMPTY;
+        template <typename Iterator>
+        void assign(Iterator first, Iterator last) {
+            clear();
+            append(first, last);
+        }
 
-            return operator[](0);
+        // shifts whichever side of position is shorter, so at most size() / 2 elements are moved
+        template <typename Iterator>
+        iterator insert(const_iterator position, Iterator first, Iterator last) {
+            size_t index = position - cbegin();
+
+            if constexpr (!std::is_base_of <std::forward_iterator_tag,
+                                            typename std::iterator_traits <Iterator>::iterator_category>::value) {
+                Deque items(allocator_);
+                items.append(first, last);
+
+                return insert(position, std::make_move_iterator(items.begin()), std::make_move_iterator(items.end()));
+            } else {
+                size_t n = std::distance(first, last);
+
+                if (index == size_) {
+                    append(first, last);
+                } else if (2 * index < size_) {
+                    insertAtFront(index, first, n);
+                    notePushes(index ? &DequeStats::inserts : &DequeStats::push_front, n);
+                } else {
+                    insertAtBack(index, first, n);
+                    notePushes(&DequeStats::inserts, n);
+                }
+
+                return begin() + index;
+            }
         }
 
-        T &back() {
-            if (!size())
-                throw Errors::DE_EMPTY;
+        iterator insert(const_iterator position, const T &element) {
+            return emplace(position, element);
+        }
+
+        iterator insert(const_iterator position, T &&element) {
+            return emplace(position, std::move(element));
+        }
+
+        // the element is built before anything moves, so args may refer to elements of the deque
+        template <typename... Args>
+        iterator emplace(const_iterator position, Args &&... args) {
+            size_t index = position - cbegin();
+
+            if (index == 0) {
+                emplace_front(std::forward <Args>(args)...);
+            } else if (index == size_) {
+                emplace_back(std::forward <Args>(args)...);
+            } else {
+                T element(std::forward <Args>(args)...);
+                insert(position, std::make_move_iterator(&element), std::make_move_iterator(&element + 1));
+            }
+
+            return begin() + index;
+        }
+
+        iterator erase(const_iterator position) {
+            return erase(position, position + 1);
+        }
+
+        // like insert, shifts whichever side of the range is shorter into the gap and pops the vacated slots
+        iterator erase(const_iterator first, const_iterator last) {
+            size_t index = first - cbegin();
+            size_t n = last - first;
+            size_t tail = size_ - std::min(size_, index + n);
+
+            CheckingPolicy::require(index + n <= size_, Errors::DE_OUT_OF_RANGE);
+
+            if (!n)
+                return begin() + index;
+
+            if (index < tail) {
+                moveElements(begin_, begin_ + n, index);
+                pop_front_n(n);
+            } else {
+                moveElements(begin_ + index + n, begin_ + index, tail);
+                pop_back_n(n);
+            }
+
+            return begin() + index;
+        }
+
+        // the elements [offset, size()) as contiguous runs, one per block they touch; fills at most
+        // max_spans of them and returns how many were filled
+        size_t readable_spans(Span <const T> *spans, size_t max_spans, size_t offset = 0) const {
+            return describeRuns(begin_ + offset, size_ - std::min(offset, size_), spans, max_spans);
+        }
+
+        size_t readable_spans(Span <T> *spans, size_t max_spans, size_t offset = 0) {
+            return describeRuns(begin_ + offset, size_ - std::min(offset, size_), spans, max_spans);
+        }
+
+        // reserves room for n elements after the last one and describes it as contiguous runs, so it can be
+        // filled in place (e.g. by readv); commit_back then makes the written prefix part of the deque
+        size_t writable_back_spans(size_t n, Span <T> *spans, size_t max_spans) {
+            static_assert(std::is_trivially_copyable <T>::value, "raw storage can only be written for trivial types");
+
+            reserve_back(n);
+
+            return describeRuns(begin_ + size_, n, spans, max_spans);
+        }
+
+        void commit_back(size_t n) {
+            static_assert(std::is_trivially_copyable <T>::value, "raw storage can only be written for trivial types");
+
+            CheckingPolicy::require(n <= (block_end_ << kBlockShift) - begin_ - size_, Errors::DE_OUT_OF_RANGE);
+
+            size_ += n;
+            notePushes(&DequeStats::push_back, n);
+        }
+
+        void pop_front_n(size_t count) {
+            CheckingPolicy::require(count <= size_, Errors::DE_OUT_OF_RANGE);
+
+            size_t vacated = ((begin_ + count) >> kBlockShift) - (begin_ >> kBlockShift);
+
+            destroyRange(begin_, count);
+            begin_ += count;
+            size_ -= count;
+            notePops(&DequeStats::pop_front, count);
+
+            if (vacated) {
+                for (; vacated; --vacated)
+                    retireFrontBlock();
+
+                if (needReallocation() == ReallocationType::RT_DECREASE)
+                    reallocate(ReallocationType::RT_DECREASE, map_size_ / GrowthPolicy::kGrowthFactor);
+            }
+        }
+
+        void pop_back_n(size_t count) {
+            CheckingPolicy::require(count <= size_, Errors::DE_OUT_OF_RANGE);
+
+            size_t end = begin_ + size_;
+            size_t vacated = ((end + kBlockMask) >> kBlockShift) - ((end - count + kBlockMask) >> kBlockShift);
 
-            return operator[](size() - 1);
+            size_ -= count;
+            destroyRange(begin_ + size_, count);
+            notePops(&DequeStats::pop_back, count);
+
+            if (vacated) {
+                for (; vacated; --vacated)
+                    retireBackBlock();
+
+                if (needReallocation() == ReallocationType::RT_DECREASE)
+                    reallocate(ReallocationType::RT_DECREASE, map_size_ / GrowthPolicy::kGrowthFactor);
+            }
         }
 
-        T back() const {
-            if (!size())
-                throw Errors::DE_EMPTY;
+        T &front() {
+            CheckingPolicy::require(!empty(), Errors::DE_EMPTY);
+            return *slot(begin_);
+        }
 
-            return operator[](size() - 1);
+        const T &front() const {
+            CheckingPolicy::require(!empty(), Errors::DE_EMPTY);
+            return *slot(begin_);
+        }
+
+        T &back() {
+            CheckingPolicy::require(!empty(), Errors::DE_EMPTY);
+            return *slot(begin_ + size_ - 1);
+        }
+
+        const T &back() const {
+            CheckingPolicy::require(!empty(), Errors::DE_EMPTY);
+            return *slot(begin_ + size_ - 1);
         }
 
         const T &operator[](size_t index) const {
-            if (l_pointer_ + index + 1 > r_pointer_)
-                throw Errors::DE_OUT_OF_RANGE;
+            if constexpr (CheckingPolicy::kCheckIndex)
+                CheckingPolicy::require(index < size_, Errors::DE_OUT_OF_RANGE);
 
-            return data_[l_pointer_ + index + 1];
+            return *slot(begin_ + index);
         }
 
         T &operator[](size_t index) {
-            if (l_pointer_ + index + 1 > r_pointer_)
+            if constexpr (CheckingPolicy::kCheckIndex)
+                CheckingPolicy::require(index < size_, Errors::DE_OUT_OF_RANGE);
+
+            return *slot(begin_ + index);
+        }
+
+        const T &at(size_t index) const {
+            if (index >= size_)
+                throw Errors::DE_OUT_OF_RANGE;
+
+            return *slot(begin_ + index);
+        }
+
+        T &at(size_t index) {
+            if (index >= size_)
                 throw Errors::DE_OUT_OF_RANGE;
 
-            return data_[l_pointer_ + index + 1];
+            return *slot(begin_ + index);
         }
 
         iterator begin() {
@@ -312,37 +1290,70 @@ namespace Deque {
         }
     };
 
+    // Walks the container's storage directly: cur_ points at the element, [first_, last_) is the contiguous
+    // segment (a block, or the whole ring) it lies in, so stepping inside a segment is a pointer increment and
+    // only crossing into the next one asks the container where that is. index_ is the element's index and is
+    // all comparisons look at. Past the ends the segment is empty and cur_ is null.
+    // Dereferencing is checked only when the container's checking policy checks operator[].
     template <typename DType, typename category, typename value_type, typename difference_type, typename pointer,
               typename reference>
-    class DequeIterator : public std::iterator <category, value_type, difference_type, pointer, reference> {
+    class DequeIterator : public IteratorBase <category, value_type, difference_type, pointer, reference> {
     private:
-        long long pointer_;
+        template <typename, typename, typename, typename, typename, typename>
+        friend class DequeIterator;
+
+        pointer cur_;
+        pointer first_;
+        pointer last_;
+        long long index_;
         DType *deque_;
 
-    public:
-        DequeIterator(size_t place, DType *d) : pointer_(static_cast<long long>(place)) {
-            deque_ = d;
+        void relocate() {
+            value_type *first = nullptr;
+            value_type *last = nullptr;
+
+            cur_ = deque_ ? deque_->iteratorSegment(index_, first, last) : nullptr;
+            first_ = first;
+            last_ = last;
         }
 
-        DequeIterator(const DequeIterator <DType, category, value_type, difference_type, pointer, reference> &iter) :
-                pointer_(iter.pointer_), deque_(iter.deque_) {}
+        void check(long long index) const {
+            typedef typename std::remove_const <DType>::type Container;
+            typedef typename Container::checking_policy CheckingPolicy;
 
-        DequeIterator <DType, category, value_type, difference_type, pointer, reference> &
-        operator=(DequeIterator <DType, category, value_type, difference_type, pointer, reference> right) {
-            pointer_ = right.pointer_;
-            deque_ = right.deque_;
+            if constexpr (CheckingPolicy::kCheckIndex)
+                CheckingPolicy::require(deque_ && index >= 0 && index < static_cast<long long>(deque_->size()),
+                                        Container::Errors::DE_OUT_OF_RANGE);
+            else
+                static_cast<void>(index);
+        }
 
-            return *this;
+    public:
+        DequeIterator() : cur_(nullptr), first_(nullptr), last_(nullptr), index_(0), deque_(nullptr) {}
+
+        DequeIterator(size_t place, DType *d) : index_(static_cast<long long>(place)), deque_(d) {
+            relocate();
         }
 
+        template <typename OtherDType, typename OtherPointer, typename OtherReference,
+                  typename = typename std::enable_if <std::is_convertible <OtherDType *, DType *>::value>::type>
+        DequeIterator(const DequeIterator <OtherDType, category, value_type, difference_type, OtherPointer,
+                                           OtherReference> &iter) :
+                cur_(iter.cur_), first_(iter.first_), last_(iter.last_), index_(iter.index_), deque_(iter.deque_) {}
+
         DequeIterator <DType, category, value_type, difference_type, pointer, reference> &operator+=(long long right) {
-            pointer_ += right;
+            index_ += right;
+
+            if (cur_ && right >= first_ - cur_ && right < last_ - cur_)
+                cur_ += right;
+            else
+                relocate();
+
             return *this;
         }
 
         DequeIterator <DType, category, value_type, difference_type, pointer, reference> &operator-=(long long right) {
-            pointer_ += -right;
-            return *this;
+            return operator+=(-right);
         }
 
         DequeIterator <DType, category, value_type, difference_type, pointer, reference>
@@ -360,68 +1371,91 @@ namespace Deque {
         }
 
         difference_type
-        operator-(DequeIterator <DType, category, value_type, difference_type, pointer, reference> right) const {
-            difference_type answer = static_cast<difference_type>(pointer_) - right.pointer_;
-
-            return answer;
+        operator-(const DequeIterator <DType, category, value_type, difference_type, pointer, reference> &right) const {
+            return index_ - right.index_;
         }
 
         DequeIterator <DType, category, value_type, difference_type, pointer, reference> &operator++() {
-            return operator+=(1);
+            ++index_;
+
+            if (++cur_ == last_)
+                relocate();
+
+            return *this;
         }
 
         DequeIterator <DType, category, value_type, difference_type, pointer, reference> operator++(int) {
             DequeIterator <DType, category, value_type, difference_type, pointer, reference> temp(*this);
-            operator+=(1);
+            operator++();
 
             return temp;
         }
 
         DequeIterator <DType, category, value_type, difference_type, pointer, reference> &operator--() {
-            return operator-=(1);
+            --index_;
+
+            if (cur_ == first_)
+                relocate();
+            else
+                --cur_;
+
+            return *this;
         }
 
         DequeIterator <DType, category, value_type, difference_type, pointer, reference> operator--(int) {
             DequeIterator <DType, category, value_type, difference_type, pointer, reference> temp(*this);
-            operator-=(1);
+            operator--();
 
             return temp;
         }
 
-        bool operator==(DequeIterator <DType, category, value_type, difference_type, pointer, reference> right) const {
-            return pointer_ == right.pointer_ && deque_ == right.deque_;
+        bool
+        operator==(const DequeIterator <DType, category, value_type, difference_type, pointer, reference> &right) const {
+            return index_ == right.index_ && deque_ == right.deque_;
         }
 
-        bool operator!=(DequeIterator <DType, category, value_type, difference_type, pointer, reference> right) const {
+        bool
+        operator!=(const DequeIterator <DType, category, value_type, difference_type, pointer, reference> &right) const {
             return !operator==(right);
         }
 
-        bool operator<(DequeIterator <DType, category, value_type, difference_type, pointer, reference> right) const {
-            return pointer_ < right.pointer_ && deque_ == right.deque_;
+        bool
+        operator<(const DequeIterator <DType, category, value_type, difference_type, pointer, reference> &right) const {
+            return index_ < right.index_;
         }
 
-        bool operator>=(DequeIterator <DType, category, value_type, difference_type, pointer, reference> right) const {
+        bool
+        operator>=(const DequeIterator <DType, category, value_type, difference_type, pointer, reference> &right) const {
             return !operator<(right);
         }
 
-        bool operator>(DequeIterator <DType, category, value_type, difference_type, pointer, reference> right) const {
+        bool
+        operator>(const DequeIterator <DType, category, value_type, difference_type, pointer, reference> &right) const {
             return right < *this;
         }
 
-        bool operator<=(DequeIterator <DType, category, value_type, difference_type, pointer, reference> right) const {
+        bool
+        operator<=(const DequeIterator <DType, category, value_type, difference_type, pointer, reference> &right) const {
             return !operator>(right);
         }
 
-        reference operator*() {
-            return (*deque_)[pointer_];
+        reference operator*() const {
+            check(index_);
+            return *cur_;
         }
 
-        pointer operator->() {
-            return &(*deque_)[pointer_];
+        pointer operator->() const {
+            check(index_);
+            return cur_;
         }
 
-        reference operator[](long long index) {
-            return deque_->operator[](pointer_ + index);
+        reference operator[](long long index) const {
+            check(index_ + index);
+
+            if (cur_ && index >= first_ - cur_ && index < last_ - cur_)
+                return cur_[index];
+
+            return *(*this + index);
         }
     };
 
@@ -433,4 +1467,15 @@ namespace Deque {
     }
 }
 
+#ifdef DEQUE_HAS_PMR
+namespace Deque {
+    namespace pmr {
+        template <typename T, typename GrowthPolicy = DefaultGrowthPolicy,
+                  typename CheckingPolicy = DEQUE_CHECKING_POLICY, typename StatsPolicy = DEQUE_STATS_POLICY>
+        using Deque = ::Deque::Deque <T, std::pmr::polymorphic_allocator <T>, GrowthPolicy, CheckingPolicy,
+                                      StatsPolicy>;
+    }
+}
+#endif
+
 #endif //DEQUE_H
@@ -0,0 +1,749 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#ifndef DEQUE_ALGORITHM_H
+#define DEQUE_ALGORITHM_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+#include "deque.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) && !defined(DEQUE_NO_SIMD)
+#define DEQUE_X86_SIMD 1
+#include <immintrin.h>
+#define DEQUE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define DEQUE_X86_SIMD 0
+#endif
+
+// Searches and reductions over the contents of a Deque that walk it block by block through readable_spans
+// instead of element by element through operator[]. For 32-bit integers and floats find, count, min_max
+// and sum run SSE2 or AVX2 kernels over each block, picked at runtime from what the CPU supports; other
+// arithmetic types, builds without x86 SIMD (or with DEQUE_NO_SIMD) and the predicate forms use plain loops
+// over the blocks, which the compiler is still free to vectorize.
+namespace Deque {
+    enum class SimdLevel {
+        SL_SCALAR,
+        SL_SSE2,
+        SL_AVX2
+    };
+
+    namespace detail {
+        inline SimdLevel detectSimdLevel() {
+#if DEQUE_X86_SIMD
+            __builtin_cpu_init();
+
+            if (__builtin_cpu_supports("avx2"))
+                return SimdLevel::SL_AVX2;
+
+            return SimdLevel::SL_SSE2;
+#else
+            return SimdLevel::SL_SCALAR;
+#endif
+        }
+
+        inline std::atomic <int> &simdLimit() {
+            static std::atomic <int> limit(static_cast<int>(SimdLevel::SL_AVX2));
+            return limit;
+        }
+    }
+
+    // the widest kernels the algorithms use: what the CPU supports, capped by limit_simd_level
+    inline SimdLevel simd_level() {
+        static const SimdLevel detected = detail::detectSimdLevel();
+
+        return static_cast<SimdLevel>(std::min(static_cast<int>(detected),
+                                               detail::simdLimit().load(std::memory_order_relaxed)));
+    }
+
+    // caps the kernels for the whole process, e.g. to compare them against the scalar loops
+    inline void limit_simd_level(SimdLevel level) {
+        detail::simdLimit().store(static_cast<int>(level), std::memory_order_relaxed);
+    }
+
+    // what sum() accumulates in: 64-bit integers of the same signedness, double for float and double
+    template <typename T>
+    using SumType = typename std::conditional <std::is_floating_point <T>::value,
+            typename std::conditional <(sizeof(T) > sizeof(double)), T, double>::type,
+            typename std::conditional <std::is_signed <T>::value, long long, unsigned long long>::type>::type;
+
+    namespace detail {
+        template <typename T>
+        constexpr bool isInt32() {
+            return std::is_integral <T>::value && !std::is_same <T, bool>::value && sizeof(T) == 4;
+        }
+
+        template <typename T>
+        constexpr bool hasKernels() {
+            return DEQUE_X86_SIMD && (isInt32 <T>() || std::is_same <T, float>::value);
+        }
+
+        // each kernel handles a whole run and returns what the scalar version would, except that sums of
+        // floats are added up in a different order
+
+        template <typename T>
+        size_t findScalar(const T *data, size_t n, T value) {
+            size_t i = 0;
+
+            while (i < n && !(data[i] == value))
+                ++i;
+
+            return i;
+        }
+
+        template <typename T>
+        size_t countScalar(const T *data, size_t n, T value) {
+            size_t matches = 0;
+
+            for (size_t i = 0; i < n; ++i)
+                matches += data[i] == value;
+
+            return matches;
+        }
+
+        template <typename T>
+        void minMaxScalar(const T *data, size_t n, T &low, T &high) {
+            for (size_t i = 0; i < n; ++i) {
+                if (data[i] < low)
+                    low = data[i];
+
+                if (high < data[i])
+                    high = data[i];
+            }
+        }
+
+        template <typename T>
+        void sumScalar(const T *data, size_t n, SumType <T> &total) {
+            for (size_t i = 0; i < n; ++i)
+                total += data[i];
+        }
+
+#if DEQUE_X86_SIMD
+        // 32-bit integers; the signedness only matters to min_max and sum, the bits are compared as they are
+
+        template <typename T>
+        size_t findSse2(const T *data, size_t n, T value) {
+            std::int32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+
+            __m128i needle = _mm_set1_epi32(bits);
+            size_t i = 0;
+
+            for (; i + 4 <= n; i += 4) {
+                __m128i equal = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)), needle);
+                int mask = _mm_movemask_ps(_mm_castsi128_ps(equal));
+
+                if (mask)
+                    return i + __builtin_ctz(mask);
+            }
+
+            return i + findScalar(data + i, n - i, value);
+        }
+
+        template <typename T>
+        DEQUE_TARGET_AVX2 size_t findAvx2(const T *data, size_t n, T value) {
+            std::int32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+
+            __m256i needle = _mm256_set1_epi32(bits);
+            size_t i = 0;
+
+            for (; i + 16 <= n; i += 16) {
+                const __m256i *vectors = reinterpret_cast<const __m256i *>(data + i);
+                __m256i low = _mm256_cmpeq_epi32(_mm256_loadu_si256(vectors), needle);
+                __m256i high = _mm256_cmpeq_epi32(_mm256_loadu_si256(vectors + 1), needle);
+
+                if (!_mm256_testz_si256(_mm256_or_si256(low, high), _mm256_or_si256(low, high))) {
+                    unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(low))) |
+                                    static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(high))) << 8;
+                    return i + __builtin_ctz(mask);
+                }
+            }
+
+            return i + findScalar(data + i, n - i, value);
+        }
+
+        template <typename T>
+        size_t countSse2(const T *data, size_t n, T value) {
+            std::int32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+
+            __m128i needle = _mm_set1_epi32(bits);
+            __m128i matches = _mm_setzero_si128();
+            size_t i = 0;
+
+            // a match compares to -1, so subtracting the comparisons counts them per lane
+            for (; i + 4 <= n; i += 4)
+                matches = _mm_sub_epi32(matches, _mm_cmpeq_epi32(
+                        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)), needle));
+
+            alignas(16) std::uint32_t lanes[4];
+            _mm_store_si128(reinterpret_cast<__m128i *>(lanes), matches);
+
+            return size_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3] + countScalar(data + i, n - i, value);
+        }
+
+        template <typename T>
+        DEQUE_TARGET_AVX2 size_t countAvx2(const T *data, size_t n, T value) {
+            std::int32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+
+            __m256i needle = _mm256_set1_epi32(bits);
+            __m256i matches = _mm256_setzero_si256();
+            size_t i = 0;
+
+            for (; i + 8 <= n; i += 8)
+                matches = _mm256_sub_epi32(matches, _mm256_cmpeq_epi32(
+                        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i)), needle));
+
+            alignas(32) std::uint32_t lanes[8];
+            _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), matches);
+
+            size_t total = countScalar(data + i, n - i, value);
+
+            for (std::uint32_t lane : lanes)
+                total += lane;
+
+            return total;
+        }
+
+        // SSE2 has no 32-bit min/max, so they are built from a signed compare; unsigned values are moved
+        // into the signed range by flipping the top bit first and flipped back at the end
+        template <typename T>
+        void minMaxSse2(const T *data, size_t n, T &low, T &high) {
+            if (n < 4)
+                return minMaxScalar(data, n, low, high);
+
+            const __m128i bias = _mm_set1_epi32(std::is_signed <T>::value ? 0 : std::numeric_limits <std::int32_t>::min());
+            __m128i lows = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data)), bias);
+            __m128i highs = lows;
+            size_t i = 4;
+
+            for (; i + 4 <= n; i += 4) {
+                __m128i values = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)), bias);
+                __m128i below = _mm_cmplt_epi32(values, lows);
+                __m128i above = _mm_cmpgt_epi32(values, highs);
+
+                lows = _mm_or_si128(_mm_and_si128(below, values), _mm_andnot_si128(below, lows));
+                highs = _mm_or_si128(_mm_and_si128(above, values), _mm_andnot_si128(above, highs));
+            }
+
+            alignas(16) T lane_lows[4], lane_highs[4];
+            _mm_store_si128(reinterpret_cast<__m128i *>(lane_lows), _mm_xor_si128(lows, bias));
+            _mm_store_si128(reinterpret_cast<__m128i *>(lane_highs), _mm_xor_si128(highs, bias));
+
+            minMaxScalar(lane_lows, 4, low, high);
+            minMaxScalar(lane_highs, 4, low, high);
+            minMaxScalar(data + i, n - i, low, high);
+        }
+
+        template <typename T>
+        DEQUE_TARGET_AVX2 void minMaxAvx2(const T *data, size_t n, T &low, T &high) {
+            if (n < 8)
+                return minMaxScalar(data, n, low, high);
+
+            __m256i lows = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+            __m256i highs = lows;
+            size_t i = 8;
+
+            for (; i + 8 <= n; i += 8) {
+                __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+
+                if (std::is_signed <T>::value) {
+                    lows = _mm256_min_epi32(lows, values);
+                    highs = _mm256_max_epi32(highs, values);
+                } else {
+                    lows = _mm256_min_epu32(lows, values);
+                    highs = _mm256_max_epu32(highs, values);
+                }
+            }
+
+            alignas(32) T lane_lows[8], lane_highs[8];
+            _mm256_store_si256(reinterpret_cast<__m256i *>(lane_lows), lows);
+            _mm256_store_si256(reinterpret_cast<__m256i *>(lane_highs), highs);
+
+            minMaxScalar(lane_lows, 8, low, high);
+            minMaxScalar(lane_highs, 8, low, high);
+            minMaxScalar(data + i, n - i, low, high);
+        }
+
+        // sums are widened to 64-bit lanes: sign or zero extension by interleaving with the sign mask or zero
+        template <typename T>
+        void sumSse2(const T *data, size_t n, SumType <T> &total) {
+            __m128i sums = _mm_setzero_si128();
+            size_t i = 0;
+
+            for (; i + 4 <= n; i += 4) {
+                __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+                __m128i extension = std::is_signed <T>::value ? _mm_srai_epi32(values, 31) : _mm_setzero_si128();
+
+                sums = _mm_add_epi64(sums, _mm_unpacklo_epi32(values, extension));
+                sums = _mm_add_epi64(sums, _mm_unpackhi_epi32(values, extension));
+            }
+
+            alignas(16) SumType <T> lanes[2];
+            _mm_store_si128(reinterpret_cast<__m128i *>(lanes), sums);
+
+            total += lanes[0] + lanes[1];
+            sumScalar(data + i, n - i, total);
+        }
+
+        template <typename T>
+        DEQUE_TARGET_AVX2 void sumAvx2(const T *data, size_t n, SumType <T> &total) {
+            __m256i sums = _mm256_setzero_si256();
+            size_t i = 0;
+
+            for (; i + 8 <= n; i += 8) {
+                const __m128i *vectors = reinterpret_cast<const __m128i *>(data + i);
+                __m128i low = _mm_loadu_si128(vectors);
+                __m128i high = _mm_loadu_si128(vectors + 1);
+
+                if (std::is_signed <T>::value) {
+                    sums = _mm256_add_epi64(sums, _mm256_cvtepi32_epi64(low));
+                    sums = _mm256_add_epi64(sums, _mm256_cvtepi32_epi64(high));
+                } else {
+                    sums = _mm256_add_epi64(sums, _mm256_cvtepu32_epi64(low));
+                    sums = _mm256_add_epi64(sums, _mm256_cvtepu32_epi64(high));
+                }
+            }
+
+            alignas(32) SumType <T> lanes[4];
+            _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), sums);
+
+            total += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            sumScalar(data + i, n - i, total);
+        }
+
+        // floats; min_max leaves the result unspecified if the run holds a NaN, like a scalar loop would
+
+        inline size_t findSse2(const float *data, size_t n, float value) {
+            __m128 needle = _mm_set1_ps(value);
+            size_t i = 0;
+
+            for (; i + 4 <= n; i += 4) {
+                int mask = _mm_movemask_ps(_mm_cmpeq_ps(_mm_loadu_ps(data + i), needle));
+
+                if (mask)
+                    return i + __builtin_ctz(mask);
+            }
+
+            return i + findScalar(data + i, n - i, value);
+        }
+
+        DEQUE_TARGET_AVX2 inline size_t findAvx2(const float *data, size_t n, float value) {
+            __m256 needle = _mm256_set1_ps(value);
+            size_t i = 0;
+
+            for (; i + 16 <= n; i += 16) {
+                unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(
+                        _mm256_cmp_ps(_mm256_loadu_ps(data + i), needle, _CMP_EQ_OQ))) |
+                                static_cast<unsigned>(_mm256_movemask_ps(
+                        _mm256_cmp_ps(_mm256_loadu_ps(data + i + 8), needle, _CMP_EQ_OQ))) << 8;
+
+                if (mask)
+                    return i + __builtin_ctz(mask);
+            }
+
+            return i + findScalar(data + i, n - i, value);
+        }
+
+        inline size_t countSse2(const float *data, size_t n, float value) {
+            __m128 needle = _mm_set1_ps(value);
+            __m128i matches = _mm_setzero_si128();
+            size_t i = 0;
+
+            for (; i + 4 <= n; i += 4)
+                matches = _mm_sub_epi32(matches, _mm_castps_si128(_mm_cmpeq_ps(_mm_loadu_ps(data + i), needle)));
+
+            alignas(16) std::uint32_t lanes[4];
+            _mm_store_si128(reinterpret_cast<__m128i *>(lanes), matches);
+
+            return size_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3] + countScalar(data + i, n - i, value);
+        }
+
+        DEQUE_TARGET_AVX2 inline size_t countAvx2(const float *data, size_t n, float value) {
+            __m256 needle = _mm256_set1_ps(value);
+            __m256i matches = _mm256_setzero_si256();
+            size_t i = 0;
+
+            for (; i + 8 <= n; i += 8)
+                matches = _mm256_sub_epi32(matches, _mm256_castps_si256(
+                        _mm256_cmp_ps(_mm256_loadu_ps(data + i), needle, _CMP_EQ_OQ)));
+
+            alignas(32) std::uint32_t lanes[8];
+            _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), matches);
+
+            size_t total = countScalar(data + i, n - i, value);
+
+            for (std::uint32_t lane : lanes)
+                total += lane;
+
+            return total;
+        }
+
+        inline void minMaxSse2(const float *data, size_t n, float &low, float &high) {
+            if (n < 4)
+                return minMaxScalar(data, n, low, high);
+
+            __m128 lows = _mm_loadu_ps(data);
+            __m128 highs = lows;
+            size_t i = 4;
+
+            for (; i + 4 <= n; i += 4) {
+                __m128 values = _mm_loadu_ps(data + i);
+
+                lows = _mm_min_ps(lows, values);
+                highs = _mm_max_ps(highs, values);
+            }
+
+            alignas(16) float lane_lows[4], lane_highs[4];
+            _mm_store_ps(lane_lows, lows);
+            _mm_store_ps(lane_highs, highs);
+
+            minMaxScalar(lane_lows, 4, low, high);
+            minMaxScalar(lane_highs, 4, low, high);
+            minMaxScalar(data + i, n - i, low, high);
+        }
+
+        DEQUE_TARGET_AVX2 inline void minMaxAvx2(const float *data, size_t n, float &low, float &high) {
+            if (n < 8)
+                return minMaxScalar(data, n, low, high);
+
+            __m256 lows = _mm256_loadu_ps(data);
+            __m256 highs = lows;
+            size_t i = 8;
+
+            for (; i + 8 <= n; i += 8) {
+                __m256 values = _mm256_loadu_ps(data + i);
+
+                lows = _mm256_min_ps(lows, values);
+                highs = _mm256_max_ps(highs, values);
+            }
+
+            alignas(32) float lane_lows[8], lane_highs[8];
+            _mm256_store_ps(lane_lows, lows);
+            _mm256_store_ps(lane_highs, highs);
+
+            minMaxScalar(lane_lows, 8, low, high);
+            minMaxScalar(lane_highs, 8, low, high);
+            minMaxScalar(data + i, n - i, low, high);
+        }
+
+        // float sums are widened to double lanes
+        inline void sumSse2(const float *data, size_t n, double &total) {
+            __m128d sums = _mm_setzero_pd();
+            size_t i = 0;
+
+            for (; i + 4 <= n; i += 4) {
+                __m128 values = _mm_loadu_ps(data + i);
+
+                sums = _mm_add_pd(sums, _mm_cvtps_pd(values));
+                sums = _mm_add_pd(sums, _mm_cvtps_pd(_mm_movehl_ps(values, values)));
+            }
+
+            alignas(16) double lanes[2];
+            _mm_store_pd(lanes, sums);
+
+            total += lanes[0] + lanes[1];
+            sumScalar(data + i, n - i, total);
+        }
+
+        DEQUE_TARGET_AVX2 inline void sumAvx2(const float *data, size_t n, double &total) {
+            __m256d sums = _mm256_setzero_pd();
+            size_t i = 0;
+
+            for (; i + 8 <= n; i += 8) {
+                sums = _mm256_add_pd(sums, _mm256_cvtps_pd(_mm_loadu_ps(data + i)));
+                sums = _mm256_add_pd(sums, _mm256_cvtps_pd(_mm_loadu_ps(data + i + 4)));
+            }
+
+            alignas(32) double lanes[4];
+            _mm256_store_pd(lanes, sums);
+
+            total += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            sumScalar(data + i, n - i, total);
+        }
+#endif
+
+        template <typename T>
+        size_t findRun(const T *data, size_t n, T value) {
+#if DEQUE_X86_SIMD
+            if constexpr (hasKernels <T>()) {
+                switch (simd_level()) {
+                    case SimdLevel::SL_AVX2:
+                        return findAvx2(data, n, value);
+                    case SimdLevel::SL_SSE2:
+                        return findSse2(data, n, value);
+                    default:
+                        break;
+                }
+            }
+#endif
+            return findScalar(data, n, value);
+        }
+
+        template <typename T>
+        size_t countRun(const T *data, size_t n, T value) {
+#if DEQUE_X86_SIMD
+            if constexpr (hasKernels <T>()) {
+                switch (simd_level()) {
+                    case SimdLevel::SL_AVX2:
+                        return countAvx2(data, n, value);
+                    case SimdLevel::SL_SSE2:
+                        return countSse2(data, n, value);
+                    default:
+                        break;
+                }
+            }
+#endif
+            return countScalar(data, n, value);
+        }
+
+        template <typename T>
+        void minMaxRun(const T *data, size_t n, T &low, T &high) {
+#if DEQUE_X86_SIMD
+            if constexpr (hasKernels <T>()) {
+                switch (simd_level()) {
+                    case SimdLevel::SL_AVX2:
+                        return minMaxAvx2(data, n, low, high);
+                    case SimdLevel::SL_SSE2:
+                        return minMaxSse2(data, n, low, high);
+                    default:
+                        break;
+                }
+            }
+#endif
+            minMaxScalar(data, n, low, high);
+        }
+
+        template <typename T>
+        void sumRun(const T *data, size_t n, SumType <T> &total) {
+#if DEQUE_X86_SIMD
+            if constexpr (hasKernels <T>()) {
+                switch (simd_level()) {
+                    case SimdLevel::SL_AVX2:
+                        return sumAvx2(data, n, total);
+                    case SimdLevel::SL_SSE2:
+                        return sumSse2(data, n, total);
+                    default:
+                        break;
+                }
+            }
+#endif
+            sumScalar(data, n, total);
+        }
+
+        const size_t kRunBatch = 16;
+
+        // calls body(data, n, position) for the runs covering [offset, offset + length) until it returns false,
+        // returns whether it never did; the runs are mutable unless DequeType is const
+        template <typename DequeType, typename Body>
+        bool forEachRun(DequeType &dq, size_t offset, size_t length, Body body) {
+            typedef typename std::conditional <std::is_const <DequeType>::value,
+                    const typename DequeType::value_type, typename DequeType::value_type>::type Element;
+
+            Span <Element> spans[kRunBatch];
+
+            while (length) {
+                size_t count = dq.readable_spans(spans, kRunBatch, offset);
+
+                if (!count)
+                    break;
+
+                for (size_t i = 0; i < count && length; ++i) {
+                    size_t n = std::min(spans[i].size, length);
+
+                    if (!body(spans[i].data, n, offset))
+                        return false;
+
+                    offset += n;
+                    length -= n;
+                }
+            }
+
+            return true;
+        }
+
+        template <typename DequeType, typename Predicate>
+        size_t findIndexIf(const DequeType &dq, Predicate predicate) {
+            size_t found = dq.size();
+
+            forEachRun(dq, 0, dq.size(), [&found, &predicate](const auto *data, size_t n, size_t position) {
+                for (size_t i = 0; i < n; ++i) {
+                    if (predicate(data[i])) {
+                        found = position + i;
+                        return false;
+                    }
+                }
+
+                return true;
+            });
+
+            return found;
+        }
+
+        template <typename DequeType>
+        size_t findIndex(const DequeType &dq, const typename DequeType::value_type &value) {
+            size_t found = dq.size();
+
+            forEachRun(dq, 0, dq.size(), [&found, &value](const auto *data, size_t n, size_t position) {
+                size_t i = findRun(data, n, value);
+
+                if (i == n)
+                    return true;
+
+                found = position + i;
+                return false;
+            });
+
+            return found;
+        }
+    }
+
+    // the first element equal to value, or end()
+    template <typename T, typename Allocator, typename GrowthPolicy, typename CheckingPolicy,
+              typename StatsPolicy>
+    typename Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy>::iterator
+    find(Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy> &dq,
+         const typename Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy>::value_type &value) {
+        static_assert(std::is_arithmetic <T>::value, "find works on arithmetic types, use find_if otherwise");
+
+        return dq.begin() + detail::findIndex(dq, value);
+    }
+
+    template <typename T, typename Allocator, typename GrowthPolicy, typename CheckingPolicy,
+              typename StatsPolicy>
+    typename Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy>::const_iterator
+    find(const Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy> &dq,
+         const typename Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy>::value_type &value) {
+        static_assert(std::is_arithmetic <T>::value, "find works on arithmetic types, use find_if otherwise");
+
+        return dq.begin() + detail::findIndex(dq, value);
+    }
+
+    template <typename T, typename Allocator, typename GrowthPolicy, typename CheckingPolicy,
+              typename StatsPolicy>
+    size_t count(const Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy> &dq,
+                 const typename Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy>::value_type &value) {
+        static_assert(std::is_arithmetic <T>::value, "count works on arithmetic types, use count_if otherwise");
+
+        size_t matches = 0;
+
+        detail::forEachRun(dq, 0, dq.size(), [&matches, &value](const T *data, size_t n, size_t) {
+            matches += detail::countRun(data, n, value);
+            return true;
+        });
+
+        return matches;
+    }
+
+    // the smallest and the largest of the length elements from offset on (all of them by default),
+    // DE_EMPTY if there are none
+    template <typename T, typename Allocator, typename GrowthPolicy, typename CheckingPolicy,
+              typename StatsPolicy>
+    std::pair <T, T> min_max(const Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy> &dq,
+                             size_t offset = 0, size_t length = std::numeric_limits <size_t>::max()) {
+        static_assert(std::is_arithmetic <T>::value, "min_max works on arithmetic types");
+
+        typedef typename Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy>::Errors Errors;
+
+        length = std::min(length, dq.size() - std::min(offset, dq.size()));
+        CheckingPolicy::require(length != 0, Errors::DE_EMPTY);
+
+        std::pair <T, T> result(dq[offset], dq[offset]);
+
+        detail::forEachRun(dq, offset, length, [&result](const T *data, size_t n, size_t) {
+            detail::minMaxRun(data, n, result.first, result.second);
+            return true;
+        });
+
+        return result;
+    }
+
+    // the sum of the length elements from offset on (all of them by default), accumulated in SumType <T>
+    template <typename T, typename Allocator, typename GrowthPolicy, typename CheckingPolicy,
+              typename StatsPolicy>
+    SumType <T> sum(const Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy> &dq, size_t offset = 0,
+                    size_t length = std::numeric_limits <size_t>::max()) {
+        static_assert(std::is_arithmetic <T>::value, "sum works on arithmetic types");
+
+        SumType <T> total = 0;
+        length = std::min(length, dq.size() - std::min(offset, dq.size()));
+
+        detail::forEachRun(dq, offset, length, [&total](const T *data, size_t n, size_t) {
+            detail::sumRun(data, n, total);
+            return true;
+        });
+
+        return total;
+    }
+
+    // the predicate forms cannot be vectorized in general, but still skip the per-element iterator work
+
+    template <typename T, typename Allocator, typename GrowthPolicy, typename CheckingPolicy, typename StatsPolicy,
+              typename Predicate>
+    typename Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy>::iterator
+    find_if(Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy> &dq, Predicate predicate) {
+        return dq.begin() + detail::findIndexIf(dq, predicate);
+    }
+
+    template <typename T, typename Allocator, typename GrowthPolicy, typename CheckingPolicy, typename StatsPolicy,
+              typename Predicate>
+    typename Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy>::const_iterator
+    find_if(const Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy> &dq, Predicate predicate) {
+        return dq.begin() + detail::findIndexIf(dq, predicate);
+    }
+
+    template <typename T, typename Allocator, typename GrowthPolicy, typename CheckingPolicy, typename StatsPolicy,
+              typename Predicate>
+    size_t count_if(const Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy> &dq, Predicate predicate) {
+        size_t matches = 0;
+
+        detail::forEachRun(dq, 0, dq.size(), [&matches, &predicate](const T *data, size_t n, size_t) {
+            for (size_t i = 0; i < n; ++i)
+                matches += predicate(data[i]) ? 1 : 0;
+
+            return true;
+        });
+
+        return matches;
+    }
+
+    template <typename T, typename Allocator, typename GrowthPolicy, typename CheckingPolicy, typename StatsPolicy,
+              typename Predicate>
+    bool any_of(const Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy> &dq, Predicate predicate) {
+        return detail::findIndexIf(dq, predicate) != dq.size();
+    }
+
+    template <typename T, typename Allocator, typename GrowthPolicy, typename CheckingPolicy, typename StatsPolicy,
+              typename Predicate>
+    bool all_of(const Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy> &dq, Predicate predicate) {
+        return detail::findIndexIf(dq, [&predicate](const T &value) { return !predicate(value); }) == dq.size();
+    }
+
+    template <typename T, typename Allocator, typename GrowthPolicy, typename CheckingPolicy, typename StatsPolicy,
+              typename Predicate>
+    bool none_of(const Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy> &dq, Predicate predicate) {
+        return !any_of(dq, predicate);
+    }
+}
+
+#endif //DEQUE_ALGORITHM_H
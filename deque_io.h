@@ -0,0 +1,373 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#ifndef DEQUE_IO_H
+#define DEQUE_IO_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "deque.h"
+
+// vectored I/O straight from and into the blocks of a byte deque, without staging copies
+namespace Deque {
+    const size_t kMaxIoSpans = 64;
+
+    // writes the front of the deque to fd and removes whatever was written, returns the result of writev
+    template <typename T, typename Allocator, typename GrowthPolicy, typename CheckingPolicy,
+              typename StatsPolicy>
+    ssize_t write_front(int fd, Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy> &dq) {
+        static_assert(sizeof(T) == 1, "only byte deques can be written");
+
+        Span <const T> spans[kMaxIoSpans];
+        iovec vectors[kMaxIoSpans];
+
+        const Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy> &source = dq;
+        size_t count = source.readable_spans(spans, kMaxIoSpans);
+
+        if (!count)
+            return 0;
+
+        for (size_t i = 0; i < count; ++i)
+            vectors[i] = iovec{const_cast<T *>(spans[i].data), spans[i].size};
+
+        ssize_t written = ::writev(fd, vectors, static_cast<int>(count));
+
+        if (written > 0)
+            dq.pop_front_n(static_cast<size_t>(written));
+
+        return written;
+    }
+
+    // reads at most max_bytes from fd directly behind the last element, returns the result of readv
+    template <typename T, typename Allocator, typename GrowthPolicy, typename CheckingPolicy,
+              typename StatsPolicy>
+    ssize_t read_back(int fd, Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy> &dq, size_t max_bytes) {
+        static_assert(sizeof(T) == 1, "only byte deques can be read into");
+
+        Span <T> spans[kMaxIoSpans];
+        iovec vectors[kMaxIoSpans];
+
+        size_t count = dq.writable_back_spans(max_bytes, spans, kMaxIoSpans);
+
+        if (!count)
+            return 0;
+
+        for (size_t i = 0; i < count; ++i)
+            vectors[i] = iovec{spans[i].data, spans[i].size};
+
+        ssize_t read = ::readv(fd, vectors, static_cast<int>(count));
+
+        if (read > 0)
+            dq.commit_back(static_cast<size_t>(read));
+
+        return read;
+    }
+
+    // A snapshot file is a kSnapshotHeaderBytes header followed by the elements laid out block by block, the
+    // last block padded with zeros, so a deque with the same block size can map the file and use it as its
+    // blocks. The header checksum covers the fields before it, the data checksum all data bytes.
+    struct SnapshotHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t header_bytes;
+        std::uint64_t element_size;
+        std::uint64_t element_align;
+        std::uint64_t block_elements;
+        std::uint64_t count;
+        std::uint64_t data_bytes;
+        std::uint64_t data_checksum;
+        std::uint64_t header_checksum;
+    };
+
+    const char kSnapshotMagic[8] = {'D', 'E', 'Q', 'U', 'E', 'S', 'N', 'P'};
+    const std::uint32_t kSnapshotVersion = 1;
+    const size_t kSnapshotHeaderBytes = 4096;
+
+    // a 64-bit checksum over a byte stream that may arrive in pieces, consumed eight bytes at a time
+    class SnapshotChecksum {
+    private:
+        std::uint64_t state_;
+        unsigned char pending_[8];
+        size_t pending_size_;
+
+        void mix(std::uint64_t word) {
+            state_ = (state_ ^ word) * 0x9E3779B97F4A7C15ull;
+            state_ ^= state_ >> 29;
+        }
+
+    public:
+        SnapshotChecksum() : state_(0xCBF29CE484222325ull), pending_(), pending_size_(0) {}
+
+        void update(const void *data, size_t bytes) {
+            const unsigned char *input = static_cast<const unsigned char *>(data);
+
+            while (bytes && pending_size_) {
+                pending_[pending_size_++] = *input++;
+                --bytes;
+
+                if (pending_size_ == sizeof(pending_)) {
+                    std::uint64_t word;
+                    std::memcpy(&word, pending_, sizeof(word));
+                    mix(word);
+                    pending_size_ = 0;
+                }
+            }
+
+            for (; bytes >= sizeof(std::uint64_t); bytes -= sizeof(std::uint64_t), input += sizeof(std::uint64_t)) {
+                std::uint64_t word;
+                std::memcpy(&word, input, sizeof(word));
+                mix(word);
+            }
+
+            std::memcpy(pending_ + pending_size_, input, bytes);
+            pending_size_ += bytes;
+        }
+
+        std::uint64_t finish() {
+            std::uint64_t word = 0;
+
+            std::memcpy(&word, pending_, pending_size_);
+            mix(word ^ pending_size_);
+
+            return state_;
+        }
+    };
+
+    // the parts of a Deque that saving and loading snapshots need
+    struct SnapshotAccess {
+        template <typename DequeType>
+        static constexpr size_t blockSize() {
+            return DequeType::kBlockSize;
+        }
+
+        template <typename DequeType, typename T>
+        static void adopt(DequeType &dq, void *region, size_t region_bytes, void (*release)(void *, size_t),
+                          T *data, size_t count) {
+            dq.adoptBlocks(region, region_bytes, release, data, count);
+        }
+    };
+
+    namespace detail {
+        template <typename Errors>
+        void writeAll(int fd, iovec *vectors, size_t count) {
+            while (count) {
+                ssize_t written = ::writev(fd, vectors, static_cast<int>(std::min(count, kMaxIoSpans)));
+
+                if (written < 0) {
+                    if (errno == EINTR)
+                        continue;
+
+                    throw Errors::DE_IO_ERROR;
+                }
+
+                for (size_t done = static_cast<size_t>(written); done;) {
+                    size_t step = std::min(done, vectors->iov_len);
+
+                    vectors->iov_base = static_cast<char *>(vectors->iov_base) + step;
+                    vectors->iov_len -= step;
+                    done -= step;
+
+                    if (!vectors->iov_len) {
+                        ++vectors;
+                        --count;
+                    }
+                }
+
+                for (; count && !vectors->iov_len; --count)
+                    ++vectors;
+            }
+        }
+
+        inline void unmapRegion(void *region, size_t bytes) {
+            ::munmap(region, bytes);
+        }
+    }
+
+    // writes a snapshot of dq to fd with one writev per kMaxIoSpans block runs
+    template <typename T, typename Allocator, typename GrowthPolicy, typename CheckingPolicy,
+              typename StatsPolicy>
+    void save(int fd, const Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy> &dq) {
+        static_assert(std::is_trivially_copyable <T>::value, "only trivially copyable elements can be saved");
+
+        typedef Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy> DequeType;
+        typedef typename DequeType::Errors Errors;
+
+        const size_t block_bytes = SnapshotAccess::blockSize <DequeType>() * sizeof(T);
+        size_t data_bytes = dq.size() * sizeof(T);
+        size_t padding = (block_bytes - data_bytes % block_bytes) % block_bytes;
+
+        std::vector <unsigned char> zeros(std::max(padding, kSnapshotHeaderBytes));
+        SnapshotChecksum checksum;
+        Span <const T> spans[kMaxIoSpans];
+
+        for (size_t offset = 0; offset < dq.size();) {
+            size_t count = dq.readable_spans(spans, kMaxIoSpans, offset);
+
+            for (size_t i = 0; i < count; ++i) {
+                checksum.update(spans[i].data, spans[i].size * sizeof(T));
+                offset += spans[i].size;
+            }
+        }
+
+        checksum.update(zeros.data(), padding);
+
+        SnapshotHeader header = {};
+        std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+        header.version = kSnapshotVersion;
+        header.header_bytes = kSnapshotHeaderBytes;
+        header.element_size = sizeof(T);
+        header.element_align = alignof(T);
+        header.block_elements = SnapshotAccess::blockSize <DequeType>();
+        header.count = dq.size();
+        header.data_bytes = data_bytes + padding;
+        header.data_checksum = checksum.finish();
+
+        SnapshotChecksum header_checksum;
+        header_checksum.update(&header, offsetof(SnapshotHeader, header_checksum));
+        header.header_checksum = header_checksum.finish();
+
+        std::vector <unsigned char> page(kSnapshotHeaderBytes);
+        std::memcpy(page.data(), &header, sizeof(header));
+
+        iovec vectors[kMaxIoSpans + 1];
+        vectors[0] = iovec{page.data(), page.size()};
+        detail::writeAll <Errors>(fd, vectors, 1);
+
+        for (size_t offset = 0; offset < dq.size();) {
+            size_t count = dq.readable_spans(spans, kMaxIoSpans, offset);
+
+            for (size_t i = 0; i < count; ++i) {
+                vectors[i] = iovec{const_cast<T *>(spans[i].data), spans[i].size * sizeof(T)};
+                offset += spans[i].size;
+            }
+
+            detail::writeAll <Errors>(fd, vectors, count);
+        }
+
+        vectors[0] = iovec{zeros.data(), padding};
+        detail::writeAll <Errors>(fd, vectors, padding ? 1 : 0);
+    }
+
+    template <typename T, typename Allocator, typename GrowthPolicy, typename CheckingPolicy,
+              typename StatsPolicy>
+    void save(const std::string &path, const Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy> &dq) {
+        typedef typename Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy>::Errors Errors;
+
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+        if (fd < 0)
+            throw Errors::DE_IO_ERROR;
+
+        try {
+            save(fd, dq);
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+
+        if (::close(fd) != 0)
+            throw Errors::DE_IO_ERROR;
+    }
+
+    // Maps the snapshot at path privately and, if it was saved with the same block size and its data is padded
+    // to whole blocks, adopts the mapping as the deque's blocks, so loading costs an mmap plus the checksum pass;
+    // verify_checksum = false skips that pass too. Otherwise the elements are copied out of the mapping. Throws
+    // DE_IO_ERROR or DE_BAD_FORMAT.
+    template <typename DequeType>
+    DequeType load(const std::string &path, bool verify_checksum = true) {
+        typedef typename DequeType::value_type T;
+        typedef typename DequeType::Errors Errors;
+
+        static_assert(std::is_trivially_copyable <T>::value, "only trivially copyable elements can be loaded");
+
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if (fd < 0)
+            throw Errors::DE_IO_ERROR;
+
+        struct stat status;
+        void *region = MAP_FAILED;
+        size_t bytes = 0;
+
+        if (::fstat(fd, &status) == 0 && status.st_size >= static_cast<off_t>(kSnapshotHeaderBytes)) {
+            bytes = static_cast<size_t>(status.st_size);
+            region = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        }
+
+        ::close(fd);
+
+        if (region == MAP_FAILED)
+            throw Errors::DE_IO_ERROR;
+
+        SnapshotHeader header;
+        std::memcpy(&header, region, sizeof(header));
+
+        SnapshotChecksum header_checksum;
+        header_checksum.update(&header, offsetof(SnapshotHeader, header_checksum));
+
+        const char *data = static_cast<const char *>(region) + kSnapshotHeaderBytes;
+        bool valid = std::memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) == 0 &&
+                     header.version == kSnapshotVersion && header.header_bytes == kSnapshotHeaderBytes &&
+                     header.header_checksum == header_checksum.finish() && header.element_size == sizeof(T) &&
+                     header.element_align == alignof(T) && header.count <= header.data_bytes / sizeof(T) &&
+                     header.data_bytes <= bytes - kSnapshotHeaderBytes;
+
+        if (valid && verify_checksum) {
+            SnapshotChecksum checksum;
+            checksum.update(data, header.data_bytes);
+            valid = checksum.finish() == header.data_checksum;
+        }
+
+        if (!valid) {
+            ::munmap(region, bytes);
+            throw Errors::DE_BAD_FORMAT;
+        }
+
+        T *elements = reinterpret_cast<T *>(const_cast<char *>(data));
+        DequeType dq;
+        size_t block_elements = SnapshotAccess::blockSize <DequeType>();
+
+        // adopted blocks are used whole, so the data section has to cover the last one up to its end
+        if (header.block_elements == block_elements &&
+            header.data_bytes / sizeof(T) / block_elements >= (header.count + block_elements - 1) / block_elements) {
+            SnapshotAccess::adopt(dq, region, bytes, &detail::unmapRegion, elements, header.count);
+            return dq;
+        }
+
+        try {
+            dq.append(elements, elements + header.count);
+        } catch (...) {
+            ::munmap(region, bytes);
+            throw;
+        }
+
+        ::munmap(region, bytes);
+        return dq;
+    }
+}
+
+#endif //DEQUE_IO_H
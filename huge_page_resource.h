@@ -0,0 +1,275 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#ifndef HUGE_PAGE_RESOURCE_H
+#define HUGE_PAGE_RESOURCE_H
+
+#include "deque.h"
+
+#ifdef DEQUE_HAS_PMR
+
+#include <cstdint>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#define DEQUE_HAS_MMAP 1
+#endif
+
+// Storage for large deques: a memory resource whose allocations are all cache-line aligned and which, once
+// more than `threshold` bytes are live, carves blocks out of 2 MiB-aligned anonymous mappings advised with
+// MADV_HUGEPAGE. With transparent huge pages each 2 MiB of blocks then costs one TLB entry instead of 512,
+// which is what random operator[] over hundreds of MB is bound by. Below the threshold, where the deque fits
+// the TLB anyway, and wherever mmap fails or is unavailable, allocations go to `upstream`. If the kernel
+// rejects the advice the mappings are still used, just with ordinary pages; huge_pages() tells which.
+//
+// Blocks freed inside a chunk are kept for reuse and the chunks are only returned to the system when the
+// resource is destroyed, so it must outlive its deques. Like std::pmr::unsynchronized_pool_resource it is not
+// thread-safe.
+//
+//     Deque::HugePageResource resource;
+//     Deque::pmr::Deque <int> dq(&resource);
+namespace Deque {
+    class HugePageResource : public std::pmr::memory_resource {
+    public:
+        static constexpr size_t kHugePageSize = size_t(2) << 20;
+        static constexpr size_t kDefaultThreshold = size_t(32) << 20;
+
+    private:
+        // blocks are carved from chunks of this size, larger allocations get a mapping of their own
+        static constexpr size_t kChunkBytes = 16 * kHugePageSize;
+        static constexpr size_t kDedicatedBytes = kChunkBytes / 4;
+
+        struct Mapping {
+            char *data;
+            size_t size;
+            size_t used;  // chunks are carved from the front
+        };
+
+        // freed chunk allocations of one size, linked through their first bytes
+        struct FreeList {
+            size_t bytes;
+            void *head;
+        };
+
+        size_t threshold_;
+        std::pmr::memory_resource *upstream_;
+        std::vector <Mapping> chunks_;
+        std::vector <Mapping> dedicated_;
+        std::vector <FreeList> free_lists_;
+        size_t live_bytes_;
+        size_t mapped_bytes_;
+        bool huge_pages_;
+
+        static size_t roundUp(size_t value, size_t alignment) {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        // a kHugePageSize-aligned anonymous mapping of `size` bytes, or null
+        char *mapAligned(size_t size) {
+#ifdef DEQUE_HAS_MMAP
+            size_t padded = size + kHugePageSize;
+            void *raw = ::mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+            if (raw == MAP_FAILED)
+                return nullptr;
+
+            char *begin = static_cast<char *>(raw);
+            char *data = reinterpret_cast<char *>(roundUp(reinterpret_cast<uintptr_t>(begin), kHugePageSize));
+
+            if (data != begin)
+                ::munmap(begin, static_cast<size_t>(data - begin));
+
+            if (data + size != begin + padded)
+                ::munmap(data + size, static_cast<size_t>(begin + padded - (data + size)));
+
+#ifdef MADV_HUGEPAGE
+            if (::madvise(data, size, MADV_HUGEPAGE) != 0)
+                huge_pages_ = false;
+#else
+            huge_pages_ = false;
+#endif
+            mapped_bytes_ += size;
+            return data;
+#else
+            static_cast<void>(size);
+            return nullptr;
+#endif
+        }
+
+        void unmap(const Mapping &mapping) {
+#ifdef DEQUE_HAS_MMAP
+            ::munmap(mapping.data, mapping.size);
+            mapped_bytes_ -= mapping.size;
+#else
+            static_cast<void>(mapping);
+#endif
+        }
+
+        FreeList *freeList(size_t bytes) {
+            for (FreeList &list : free_lists_) {
+                if (list.bytes == bytes)
+                    return &list;
+            }
+
+            return nullptr;
+        }
+
+        void *allocateMapped(size_t bytes, size_t alignment) {
+            if (bytes >= kDedicatedBytes) {
+                size_t size = roundUp(bytes, kHugePageSize);
+                dedicated_.reserve(dedicated_.size() + 1);
+                char *data = mapAligned(size);
+
+                if (data)
+                    dedicated_.push_back(Mapping{data, size, size});
+
+                return data;
+            }
+
+            // made here rather than when the first block comes back, so deallocation never allocates
+            FreeList *list = freeList(bytes);
+
+            if (!list) {
+                free_lists_.push_back(FreeList{bytes, nullptr});
+                list = &free_lists_.back();
+            }
+
+            if (list->head) {
+                void *block = list->head;
+                list->head = *static_cast<void **>(block);
+                return block;
+            }
+
+            if (chunks_.empty() || roundUp(chunks_.back().used, alignment) + bytes > chunks_.back().size) {
+                chunks_.reserve(chunks_.size() + 1);
+                char *data = mapAligned(kChunkBytes);
+
+                if (!data)
+                    return nullptr;
+
+                chunks_.push_back(Mapping{data, kChunkBytes, 0});
+            }
+
+            Mapping &chunk = chunks_.back();
+            size_t offset = roundUp(chunk.used, alignment);
+            chunk.used = offset + bytes;
+            return chunk.data + offset;
+        }
+
+        static bool contains(const Mapping &mapping, const void *pointer) {
+            const char *address = static_cast<const char *>(pointer);
+            return address >= mapping.data && address < mapping.data + mapping.size;
+        }
+
+        // false if `pointer` did not come from a mapping
+        bool deallocateMapped(void *pointer, size_t bytes) {
+            for (size_t i = 0; i < dedicated_.size(); ++i) {
+                if (dedicated_[i].data == pointer) {
+                    unmap(dedicated_[i]);
+                    dedicated_[i] = dedicated_.back();
+                    dedicated_.pop_back();
+                    return true;
+                }
+            }
+
+            for (const Mapping &chunk : chunks_) {
+                if (contains(chunk, pointer)) {
+                    FreeList *list = freeList(bytes);
+                    *static_cast<void **>(pointer) = list->head;
+                    list->head = pointer;
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+    protected:
+        void *do_allocate(size_t bytes, size_t alignment) override {
+            alignment = std::max(alignment, kCacheLineSize);
+            bytes = roundUp(std::max <size_t>(bytes, 1), kCacheLineSize);
+
+            // free lists are found by size alone, so the chunks only serve alignments every offset satisfies
+            void *pointer = nullptr;
+
+            if (live_bytes_ + bytes > threshold_ && alignment <= kCacheLineSize)
+                pointer = allocateMapped(bytes, alignment);
+
+            if (!pointer)
+                pointer = upstream_->allocate(bytes, alignment);
+
+            live_bytes_ += bytes;
+            return pointer;
+        }
+
+        void do_deallocate(void *pointer, size_t bytes, size_t alignment) override {
+            alignment = std::max(alignment, kCacheLineSize);
+            bytes = roundUp(std::max <size_t>(bytes, 1), kCacheLineSize);
+            live_bytes_ -= bytes;
+
+            if (!deallocateMapped(pointer, bytes))
+                upstream_->deallocate(pointer, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+            return this == &other;
+        }
+
+    public:
+        explicit HugePageResource(size_t threshold = kDefaultThreshold,
+                                  std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+                : threshold_(threshold), upstream_(upstream), live_bytes_(0), mapped_bytes_(0), huge_pages_(true) {}
+
+        HugePageResource(const HugePageResource &) = delete;
+        HugePageResource &operator=(const HugePageResource &) = delete;
+
+        ~HugePageResource() override {
+            for (const Mapping &mapping : dedicated_)
+                unmap(mapping);
+
+            for (const Mapping &chunk : chunks_)
+                unmap(chunk);
+        }
+
+        std::pmr::memory_resource *upstream_resource() const {
+            return upstream_;
+        }
+
+        size_t threshold() const {
+            return threshold_;
+        }
+
+        // bytes handed out and not yet returned, wherever they came from
+        size_t live_bytes() const {
+            return live_bytes_;
+        }
+
+        // bytes of address space held in 2 MiB-aligned mappings
+        size_t mapped_bytes() const {
+            return mapped_bytes_;
+        }
+
+        // whether there are mappings and the kernel accepted MADV_HUGEPAGE for every one of them
+        bool huge_pages() const {
+            return huge_pages_ && mapped_bytes_ != 0;
+        }
+    };
+}
+
+#endif
+
+#endif //HUGE_PAGE_RESOURCE_H
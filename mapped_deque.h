@@ -0,0 +1,360 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#ifndef MAPPED_DEQUE_H
+#define MAPPED_DEQUE_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <string>
+#include <vector>
+
+#include "deque.h"
+
+// A deque of trivially copyable elements kept in fixed-size segments of a file, mapped into memory only
+// while they are needed. The head and tail segments always stay mapped; at most memory_budget bytes of
+// segments are mapped at once, cold middle segments are unmapped to make room. Unmapping leaves their dirty
+// pages to the kernel's normal writeback; the clean ones are dropped from the page cache at once. Popped
+// segments return their file slot to a free list for the next push, slots beyond a few spares have their
+// disk space released where the file system can punch holes.
+//
+// The file is created in `directory` and unlinked at once, so nothing is left behind. A reference to an
+// element stays valid until the next call that maps a segment in: operator[]/at on a cold segment, or a
+// push or pop that crosses a segment boundary.
+namespace Deque {
+    template <typename T, typename CheckingPolicy = DEQUE_CHECKING_POLICY>
+    class MappedDeque {
+    private:
+        static_assert(std::is_trivially_copyable <T>::value, "MappedDeque keeps elements as raw bytes in a file");
+
+        // popped segment slots kept with their disk space, the rest are hole-punched
+        static constexpr size_t kSpareSegments = 2;
+
+        struct Segment {
+            size_t slot;  // index of the segment-sized region of the file
+            T *data;      // null while unmapped
+        };
+
+        int fd_;
+        size_t segment_bytes_;
+        size_t segment_elements_;
+        size_t budget_segments_;
+
+        // segment i holds positions [i * segment_elements_, (i + 1) * segment_elements_), begin_ is in the first.
+        // Which segments are mapped is a cache, so const reads may change it.
+        mutable Deque <Segment> segments_;
+        Deque <size_t> free_slots_;
+        size_t file_slots_;
+        mutable size_t resident_;
+        mutable size_t hand_;  // where the search for a segment to unmap resumes
+        bool punch_holes_;     // cleared once the file system turns hole punching down
+        size_t begin_;
+        size_t size_;
+
+        void map(Segment &segment) const {
+            void *data = ::mmap(nullptr, segment_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_,
+                                static_cast<off_t>(segment.slot * segment_bytes_));
+
+            if (data == MAP_FAILED)
+                throw Errors::DE_IO_ERROR;
+
+            segment.data = static_cast<T *>(data);
+            ++resident_;
+        }
+
+        void unmap(Segment &segment, bool drop_pages) const {
+            ::munmap(segment.data, segment_bytes_);
+            segment.data = nullptr;
+            --resident_;
+
+            if (drop_pages)
+                ::posix_fadvise(fd_, static_cast<off_t>(segment.slot * segment_bytes_),
+                                static_cast<off_t>(segment_bytes_), POSIX_FADV_DONTNEED);
+        }
+
+        // unmaps middle segments, other than `keep`, until there is room for one more
+        void makeResidentRoom(size_t keep) const {
+            size_t count = segments_.size();
+
+            for (size_t scanned = 0; resident_ >= budget_segments_ && scanned < count; ++scanned) {
+                hand_ = hand_ + 1 < count ? hand_ + 1 : 0;
+
+                if (hand_ != 0 && hand_ + 1 != count && hand_ != keep && segments_[hand_].data)
+                    unmap(segments_[hand_], true);
+            }
+        }
+
+        Segment &resident(size_t number) const {
+            Segment &segment = segments_[number];
+
+            if (!segment.data) {
+                makeResidentRoom(number);
+                map(segment);
+            }
+
+            return segment;
+        }
+
+        Segment newSegment() {
+            Segment segment{0, nullptr};
+
+            if (!free_slots_.empty()) {
+                segment.slot = free_slots_.back();
+                free_slots_.pop_back();
+            } else {
+                if (::ftruncate(fd_, static_cast<off_t>((file_slots_ + 1) * segment_bytes_)) != 0)
+                    throw Errors::DE_IO_ERROR;
+
+                segment.slot = file_slots_++;
+            }
+
+            try {
+                makeResidentRoom(segments_.size());
+                map(segment);
+            } catch (...) {
+                free_slots_.push_back(segment.slot);
+                throw;
+            }
+
+            return segment;
+        }
+
+        // gives the disk space of a file slot back; a slot that keeps its space is still reused by the next push
+        void punchHole(size_t slot) {
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+            if (::fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                            static_cast<off_t>(slot * segment_bytes_), static_cast<off_t>(segment_bytes_)) != 0 &&
+                    (errno == EOPNOTSUPP || errno == ENOSYS))
+                punch_holes_ = false;
+#else
+            (void) slot;
+            punch_holes_ = false;
+#endif
+        }
+
+        void releaseSegment(Segment segment) {
+            if (segment.data)
+                unmap(segment, false);
+
+            if (punch_holes_ && free_slots_.size() >= kSpareSegments)
+                punchHole(segment.slot);
+
+            free_slots_.push_back(segment.slot);
+        }
+
+        // the segment is mapped and holds a file slot before the map of segments grows, so give both back if
+        // that throws
+        template <typename Push>
+        void addSegment(Push push) {
+            Segment segment = newSegment();
+
+            try {
+                push(segment);
+            } catch (...) {
+                releaseSegment(segment);
+                throw;
+            }
+        }
+
+        T &element(size_t position) const {
+            return resident(position / segment_elements_).data[position % segment_elements_];
+        }
+
+    public:
+        enum class Errors {
+            DE_EMPTY,
+            DE_INTERNAL_ERROR,
+            DE_FULL,
+            DE_OUT_OF_RANGE,
+            DE_IO_ERROR
+        };
+
+        typedef T value_type;
+        typedef CheckingPolicy checking_policy;
+        typedef size_t size_type;
+        typedef T &reference;
+        typedef const T &const_reference;
+
+        static constexpr size_t kDefaultSegmentBytes = size_t(16) << 20;
+
+        // segment_bytes is rounded up to whole pages, memory_budget to at least three segments: head, tail and
+        // one for random access
+        MappedDeque(const std::string &directory, size_t memory_budget, size_t segment_bytes = kDefaultSegmentBytes) :
+                fd_(-1), file_slots_(0), resident_(0), hand_(0), punch_holes_(true), begin_(0), size_(0) {
+            size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+
+            segment_bytes_ = (std::max(segment_bytes, sizeof(T)) + page - 1) / page * page;
+            segment_elements_ = segment_bytes_ / sizeof(T);
+            budget_segments_ = std::max <size_t>(3, memory_budget / segment_bytes_);
+
+            std::vector <char> path(directory.begin(), directory.end());
+            const char suffix[] = "/mapped-deque-XXXXXX";
+
+            path.insert(path.end(), suffix, suffix + sizeof(suffix));
+            fd_ = ::mkstemp(path.data());
+
+            if (fd_ < 0)
+                throw Errors::DE_IO_ERROR;
+
+            ::unlink(path.data());
+        }
+
+        MappedDeque(const MappedDeque &) = delete;
+        MappedDeque &operator=(const MappedDeque &) = delete;
+
+        ~MappedDeque() {
+            clear();
+            ::close(fd_);
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+        bool empty() const {
+            return size_ == 0;
+        }
+
+        size_t segment_elements() const {
+            return segment_elements_;
+        }
+
+        size_t resident_segments() const {
+            return resident_;
+        }
+
+        size_t segments() const {
+            return segments_.size();
+        }
+
+        void clear() {
+            while (!segments_.empty()) {
+                releaseSegment(segments_.back());
+                segments_.pop_back();
+            }
+
+            begin_ = size_ = 0;
+        }
+
+        // by value: making room for a new segment may unmap the one an argument referring into the deque lies in
+        void push_back(T value) {
+            size_t end = begin_ + size_;
+
+            if (end == segments_.size() * segment_elements_)
+                addSegment([this](const Segment &segment) { segments_.push_back(segment); });
+
+            segments_.back().data[end % segment_elements_] = value;
+            ++size_;
+        }
+
+        void push_front(T value) {
+            if (begin_ == 0) {
+                addSegment([this](const Segment &segment) { segments_.push_front(segment); });
+                begin_ = segment_elements_;
+                hand_ = hand_ + 1 < segments_.size() ? hand_ + 1 : 0;
+            }
+
+            segments_.front().data[--begin_] = value;
+            ++size_;
+        }
+
+        void pop_front() {
+            CheckingPolicy::require(size_ != 0, Errors::DE_EMPTY);
+
+            if (--size_ == 0) {
+                clear();
+                return;
+            }
+
+            if (++begin_ == segment_elements_) {
+                releaseSegment(segments_.front());
+                segments_.pop_front();
+                begin_ = 0;
+                hand_ = hand_ ? hand_ - 1 : 0;
+                resident(0);
+            }
+        }
+
+        void pop_back() {
+            CheckingPolicy::require(size_ != 0, Errors::DE_EMPTY);
+
+            if (--size_ == 0) {
+                clear();
+                return;
+            }
+
+            if ((begin_ + size_) % segment_elements_ == 0) {
+                releaseSegment(segments_.back());
+                segments_.pop_back();
+                resident(segments_.size() - 1);
+            }
+        }
+
+        T &front() {
+            CheckingPolicy::require(size_ != 0, Errors::DE_EMPTY);
+            return segments_.front().data[begin_];
+        }
+
+        const T &front() const {
+            CheckingPolicy::require(size_ != 0, Errors::DE_EMPTY);
+            return segments_.front().data[begin_];
+        }
+
+        T &back() {
+            CheckingPolicy::require(size_ != 0, Errors::DE_EMPTY);
+            return segments_.back().data[(begin_ + size_ - 1) % segment_elements_];
+        }
+
+        const T &back() const {
+            CheckingPolicy::require(size_ != 0, Errors::DE_EMPTY);
+            return segments_.back().data[(begin_ + size_ - 1) % segment_elements_];
+        }
+
+        // may map the element's segment in, unmapping a cold one
+        T &operator[](size_t index) {
+            if constexpr (CheckingPolicy::kCheckIndex)
+                CheckingPolicy::require(index < size_, Errors::DE_OUT_OF_RANGE);
+
+            return element(begin_ + index);
+        }
+
+        const T &operator[](size_t index) const {
+            if constexpr (CheckingPolicy::kCheckIndex)
+                CheckingPolicy::require(index < size_, Errors::DE_OUT_OF_RANGE);
+
+            return element(begin_ + index);
+        }
+
+        T &at(size_t index) {
+            if (index >= size_)
+                throw Errors::DE_OUT_OF_RANGE;
+
+            return element(begin_ + index);
+        }
+
+        const T &at(size_t index) const {
+            if (index >= size_)
+                throw Errors::DE_OUT_OF_RANGE;
+
+            return element(begin_ + index);
+        }
+    };
+}
+
+#endif //MAPPED_DEQUE_H
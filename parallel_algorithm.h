@@ -0,0 +1,360 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#ifndef PARALLEL_ALGORITHM_H
+#define PARALLEL_ALGORITHM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "deque.h"
+#include "deque_algorithm.h"
+#include "work_stealing_deque.h"
+
+// for_each, transform, reduce and sort over a Deque, split into index ranges that the workers of a ThreadPool
+// share by work stealing; inside a range the elements are walked block by block
+namespace Deque {
+    // A parallel-for over a fixed set of workers, each owning a WorkStealingDeque of ranges. A worker splits
+    // the range it holds in halves, keeps the left one and pushes the right one for thieves, so idle workers
+    // steal the largest pieces left. The calling thread works as worker 0; calls from different threads are
+    // serialized and a body must not call back into the same pool.
+    class ThreadPool {
+    private:
+        // in units of grains, so that 32-bit bounds cover any size
+        struct Range {
+            std::uint32_t begin;
+            std::uint32_t end;
+        };
+
+        typedef std::function <void(size_t, size_t)> Body;
+
+        std::vector <std::unique_ptr <WorkStealingDeque <Range>>> deques_;
+        std::vector <std::thread> threads_;
+
+        std::mutex call_mutex_;
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        size_t generation_ = 0;
+        bool stopping_ = false;
+
+        const Body *body_ = nullptr;
+        size_t size_ = 0;
+        size_t grain_ = 1;
+        std::atomic <size_t> remaining_{0};
+        std::atomic <size_t> busy_{0};
+        std::atomic <bool> failed_{false};
+        std::exception_ptr error_;
+
+        bool steal(size_t self, std::minstd_rand &random, Range &range) {
+            size_t workers = deques_.size();
+
+            for (size_t attempt = 0; attempt < workers; ++attempt) {
+                size_t victim = random() % workers;
+
+                if (victim != self && deques_[victim]->steal(range))
+                    return true;
+            }
+
+            return false;
+        }
+
+        void work(size_t self) {
+            std::minstd_rand random(static_cast<std::minstd_rand::result_type>(self + 1));
+            WorkStealingDeque <Range> &own = *deques_[self];
+            Range range;
+
+            while (remaining_.load(std::memory_order_acquire)) {
+                if (!own.pop_back(range) && !steal(self, random, range)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                while (range.end - range.begin > 1) {
+                    std::uint32_t middle = range.begin + (range.end - range.begin) / 2;
+
+                    own.push_back(Range{middle, range.end});
+                    range.end = middle;
+                }
+
+                // after a failure the remaining ranges are only counted off
+                try {
+                    if (!failed_.load(std::memory_order_relaxed))
+                        (*body_)(range.begin * grain_, std::min(range.end * grain_, size_));
+                } catch (...) {
+                    std::lock_guard <std::mutex> lock(mutex_);
+
+                    if (!error_)
+                        error_ = std::current_exception();
+
+                    failed_.store(true, std::memory_order_relaxed);
+                }
+
+                remaining_.fetch_sub(range.end - range.begin, std::memory_order_acq_rel);
+            }
+        }
+
+        void helper(size_t self) {
+            size_t seen = 0;
+
+            for (;;) {
+                {
+                    std::unique_lock <std::mutex> lock(mutex_);
+                    wake_.wait(lock, [this, seen] { return stopping_ || generation_ != seen; });
+
+                    if (stopping_)
+                        return;
+
+                    seen = generation_;
+                }
+
+                work(self);
+                busy_.fetch_sub(1, std::memory_order_release);
+            }
+        }
+
+    public:
+        explicit ThreadPool(size_t workers = std::thread::hardware_concurrency()) {
+            workers = std::max(workers, size_t(1));
+
+            for (size_t i = 0; i < workers; ++i)
+                deques_.emplace_back(new WorkStealingDeque <Range>());
+
+            for (size_t i = 1; i < workers; ++i)
+                threads_.emplace_back(&ThreadPool::helper, this, i);
+        }
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        ~ThreadPool() {
+            {
+                std::lock_guard <std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+
+            wake_.notify_all();
+
+            for (std::thread &thread : threads_)
+                thread.join();
+        }
+
+        size_t size() const {
+            return deques_.size();
+        }
+
+        // calls body(begin, end) on disjoint ranges of at most grain indices covering [0, n) and returns once
+        // all of them are done; rethrows the first exception a body threw, skipping the ranges not yet started
+        void parallel_for(size_t n, size_t grain, const Body &body) {
+            if (!n)
+                return;
+
+            std::lock_guard <std::mutex> call(call_mutex_);
+
+            grain_ = std::max(grain, (n - 1) / std::numeric_limits <std::uint32_t>::max() + 1);
+            body_ = &body;
+            size_ = n;
+            error_ = nullptr;
+            failed_.store(false, std::memory_order_relaxed);
+
+            size_t grains = (n + grain_ - 1) / grain_;
+            remaining_.store(grains, std::memory_order_relaxed);
+            deques_[0]->push_back(Range{0, static_cast<std::uint32_t>(grains)});
+
+            {
+                std::lock_guard <std::mutex> lock(mutex_);
+                busy_.store(threads_.size(), std::memory_order_relaxed);
+                ++generation_;
+            }
+
+            wake_.notify_all();
+            work(0);
+
+            while (busy_.load(std::memory_order_acquire))
+                std::this_thread::yield();
+
+            if (error_)
+                std::rethrow_exception(error_);
+        }
+    };
+
+    namespace detail {
+        // enough ranges for stealing to even out the load, but never ones so small the splitting shows
+        inline size_t parallelGrain(const ThreadPool &pool, size_t n) {
+            return std::max(n / (pool.size() * 16), size_t(4096));
+        }
+    }
+
+    // calls f on every element, in no particular order
+    template <typename T, typename Allocator, typename GrowthPolicy, typename CheckingPolicy, typename StatsPolicy,
+              typename Function>
+    void parallel_for_each(ThreadPool &pool, Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy> &dq,
+                           Function f) {
+        pool.parallel_for(dq.size(), detail::parallelGrain(pool, dq.size()), [&dq, &f](size_t begin, size_t end) {
+            detail::forEachRun(dq, begin, end - begin, [&f](T *data, size_t n, size_t) {
+                for (size_t i = 0; i < n; ++i)
+                    f(data[i]);
+
+                return true;
+            });
+        });
+    }
+
+    // assigns op(source[i]) to destination[i]; like std::transform the destination has to hold as many
+    // elements as the source (DE_OUT_OF_RANGE otherwise) and may be the source itself
+    template <typename T, typename Allocator, typename GrowthPolicy, typename CheckingPolicy, typename StatsPolicy,
+              typename U, typename OutAllocator, typename OutGrowthPolicy, typename OutCheckingPolicy,
+              typename OutStatsPolicy, typename Operation>
+    void parallel_transform(ThreadPool &pool,
+                            const Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy> &source,
+                            Deque <U, OutAllocator, OutGrowthPolicy, OutCheckingPolicy, OutStatsPolicy> &destination,
+                            Operation op) {
+        typedef typename Deque <U, OutAllocator, OutGrowthPolicy, OutCheckingPolicy, OutStatsPolicy>::Errors Errors;
+
+        OutCheckingPolicy::require(destination.size() >= source.size(), Errors::DE_OUT_OF_RANGE);
+
+        pool.parallel_for(source.size(), detail::parallelGrain(pool, source.size()),
+                          [&source, &destination, &op](size_t begin, size_t end) {
+            detail::forEachRun(source, begin, end - begin, [&destination, &op](const T *input, size_t n, size_t from) {
+                return detail::forEachRun(destination, from, n, [input, from, &op](U *output, size_t m, size_t to) {
+                    for (size_t i = 0; i < m; ++i)
+                        output[i] = op(input[to - from + i]);
+
+                    return true;
+                });
+            });
+        });
+    }
+
+    // folds all elements with op, starting from init; each range is folded starting from its first element
+    // converted to Result, and the partial results are combined in index order, so op has to be associative
+    // but need not be commutative
+    template <typename T, typename Allocator, typename GrowthPolicy, typename CheckingPolicy, typename StatsPolicy,
+              typename Result, typename Operation>
+    Result parallel_reduce(ThreadPool &pool,
+                           const Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy> &dq,
+                           Result init, Operation op) {
+        std::mutex mutex;
+        std::vector <std::pair <size_t, Result>> partials;
+
+        pool.parallel_for(dq.size(), detail::parallelGrain(pool, dq.size()),
+                          [&dq, &op, &mutex, &partials](size_t begin, size_t end) {
+            Result partial = dq[begin];
+
+            detail::forEachRun(dq, begin + 1, end - begin - 1, [&partial, &op](const T *data, size_t n, size_t) {
+                for (size_t i = 0; i < n; ++i)
+                    partial = op(std::move(partial), data[i]);
+
+                return true;
+            });
+
+            std::lock_guard <std::mutex> lock(mutex);
+            partials.emplace_back(begin, std::move(partial));
+        });
+
+        std::sort(partials.begin(), partials.end(),
+                  [](const std::pair <size_t, Result> &left, const std::pair <size_t, Result> &right) {
+                      return left.first < right.first;
+                  });
+
+        for (std::pair <size_t, Result> &partial : partials)
+            init = op(std::move(init), std::move(partial.second));
+
+        return init;
+    }
+
+    // Sorts the elements, not stably. They are moved into a buffer, which is cut into pieces sorted in
+    // parallel, then merged pairwise in rounds going back and forth between the deque and the buffer.
+    template <typename T, typename Allocator, typename GrowthPolicy, typename CheckingPolicy, typename StatsPolicy,
+              typename Compare = std::less <T>>
+    void parallel_sort(ThreadPool &pool, Deque <T, Allocator, GrowthPolicy, CheckingPolicy, StatsPolicy> &dq,
+                       Compare compare = Compare()) {
+        size_t n = dq.size();
+        size_t pieces = std::min(pool.size() * 4, std::max(n / 4096, size_t(1)));
+
+        if (pieces == 1) {
+            std::sort(dq.begin(), dq.end(), compare);
+            return;
+        }
+
+        std::vector <T> buffer(std::make_move_iterator(dq.begin()), std::make_move_iterator(dq.end()));
+        std::vector <size_t> bounds;
+
+        for (size_t i = 0; i <= pieces; ++i)
+            bounds.push_back(n * i / pieces);
+
+        pool.parallel_for(pieces, 1, [&buffer, &bounds, &compare](size_t begin, size_t end) {
+            for (size_t piece = begin; piece < end; ++piece)
+                std::sort(buffer.begin() + bounds[piece], buffer.begin() + bounds[piece + 1], compare);
+        });
+
+        bool in_buffer = true;
+
+        for (; bounds.size() > 2; in_buffer = !in_buffer) {
+            size_t pairs = (bounds.size() - 1) / 2;
+
+            pool.parallel_for(bounds.size() - 1 - pairs, 1,
+                              [&dq, &buffer, &bounds, &compare, in_buffer, pairs](size_t begin, size_t end) {
+                for (size_t pair = begin; pair < end; ++pair) {
+                    size_t first = bounds[2 * pair];
+                    size_t middle = bounds[std::min(2 * pair + 1, bounds.size() - 1)];
+                    size_t last = pair < pairs ? bounds[2 * pair + 2] : middle;
+
+                    if (in_buffer) {
+                        std::merge(std::make_move_iterator(buffer.begin() + first),
+                                   std::make_move_iterator(buffer.begin() + middle),
+                                   std::make_move_iterator(buffer.begin() + middle),
+                                   std::make_move_iterator(buffer.begin() + last), dq.begin() + first, compare);
+                    } else {
+                        std::merge(std::make_move_iterator(dq.begin() + first),
+                                   std::make_move_iterator(dq.begin() + middle),
+                                   std::make_move_iterator(dq.begin() + middle),
+                                   std::make_move_iterator(dq.begin() + last), buffer.begin() + first, compare);
+                    }
+                }
+            });
+
+            std::vector <size_t> merged;
+
+            for (size_t i = 0; i < bounds.size(); i += 2)
+                merged.push_back(bounds[i]);
+
+            if (merged.back() != n)
+                merged.push_back(n);
+
+            bounds.swap(merged);
+        }
+
+        if (in_buffer) {
+            pool.parallel_for(n, detail::parallelGrain(pool, n), [&dq, &buffer](size_t begin, size_t end) {
+                std::move(buffer.begin() + begin, buffer.begin() + end, dq.begin() + begin);
+            });
+        }
+    }
+}
+
+#endif //PARALLEL_ALGORITHM_H
@@ -0,0 +1,448 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#ifndef RING_DEQUE_H
+#define RING_DEQUE_H
+
+#include "deque.h"
+
+namespace Deque {
+    // a push into a full RingDeque throws DE_FULL
+    struct RejectOnOverflow {
+        static constexpr bool kOverwrite = false;
+    };
+
+    // a push into a full RingDeque drops the element at the opposite end
+    struct OverwriteOnOverflow {
+        static constexpr bool kOverwrite = true;
+    };
+
+    // fixed-capacity deque over a single power-of-two ring, storage is allocated once in the constructor
+    template <typename T, typename OverflowPolicy = RejectOnOverflow, typename Allocator = std::allocator <T>,
+              typename CheckingPolicy = DEQUE_CHECKING_POLICY>
+    class RingDeque {
+    private:
+        typedef std::allocator_traits <Allocator> AllocatorTraits;
+
+        Allocator allocator_;
+        T *data_;
+        size_t capacity_;
+        size_t mask_;
+        size_t begin_;
+        size_t size_;
+
+        T *slot(size_t position) const {
+            return data_ + (position & mask_);
+        }
+
+        void destroy(size_t position) {
+            AllocatorTraits::destroy(allocator_, slot(position));
+        }
+
+        void release() {
+            clear();
+
+            if (data_)
+                AllocatorTraits::deallocate(allocator_, data_, mask_ + 1);
+
+            data_ = nullptr;
+            capacity_ = mask_ = 0;
+        }
+
+        void swapStorage(RingDeque &other) noexcept {
+            std::swap(data_, other.data_);
+            std::swap(capacity_, other.capacity_);
+            std::swap(mask_, other.mask_);
+            std::swap(begin_, other.begin_);
+            std::swap(size_, other.size_);
+        }
+
+        // a push into a full ring that drops the element at the opposite end. The new element is built before
+        // that one is destroyed, so args may refer to it and a throwing constructor leaves the ring unchanged;
+        // when both share a slot (capacity is a power of two) it is built aside and moved in.
+        template <bool kBack, typename... Args>
+        T &overwrite(Args &&... args) {
+            size_t to = kBack ? begin_ + size_ : begin_ - 1;
+            size_t evicted = kBack ? begin_ : begin_ + size_ - 1;
+
+            if (slot(to) != slot(evicted)) {
+                AllocatorTraits::construct(allocator_, slot(to), std::forward<Args>(args)...);
+                destroy(evicted);
+            } else {
+                T element(std::forward<Args>(args)...);
+                destroy(evicted);
+
+                try {
+                    AllocatorTraits::construct(allocator_, slot(to), std::move_if_noexcept(element));
+                } catch (...) {
+                    // the evicted element is gone and nothing took its place
+                    if constexpr (kBack)
+                        ++begin_;
+
+                    --size_;
+                    throw;
+                }
+            }
+
+            if constexpr (kBack)
+                ++begin_;
+            else
+                --begin_;
+
+            return *slot(to);
+        }
+
+        template <typename, typename, typename, typename, typename, typename>
+        friend class DequeIterator;
+
+        // for iterators: the slot of element `index`, the segment is the whole ring
+        T *iteratorSegment(long long index, T *&first, T *&last) const {
+            if (!data_) {
+                first = last = nullptr;
+                return nullptr;
+            }
+
+            first = data_;
+            last = data_ + mask_ + 1;
+
+            return slot(begin_ + static_cast<size_t>(index));
+        }
+
+    public:
+        enum class Errors {
+            DE_EMPTY,
+            DE_INTERNAL_ERROR,
+            DE_FULL,
+            DE_OUT_OF_RANGE
+        };
+
+        typedef T value_type;
+        typedef Allocator allocator_type;
+        typedef CheckingPolicy checking_policy;
+        typedef size_t size_type;
+        typedef T &reference;
+        typedef const T &const_reference;
+
+        typedef DequeIterator <RingDeque, std::random_access_iterator_tag, T, long long, T *, T &> iterator;
+        typedef DequeIterator <const RingDeque, std::random_access_iterator_tag, T, long long, const T *, const T &>
+                const_iterator;
+        typedef std::reverse_iterator <iterator> reverse_iterator;
+        typedef std::reverse_iterator <const_iterator> const_reverse_iterator;
+
+        explicit RingDeque(size_t capacity, const Allocator &allocator = Allocator()) :
+                allocator_(allocator), data_(nullptr), capacity_(capacity), mask_(0), begin_(0), size_(0) {
+            if (!capacity)
+                throw Errors::DE_INTERNAL_ERROR;
+
+            while (mask_ + 1 < capacity)
+                mask_ = 2 * mask_ + 1;
+
+            data_ = AllocatorTraits::allocate(allocator_, mask_ + 1);
+        }
+
+        RingDeque(const RingDeque &old) :
+                RingDeque(old.capacity_, AllocatorTraits::select_on_container_copy_construction(old.allocator_)) {
+            for (size_t i = 0; i < old.size_; ++i)
+                push_back(old[i]);
+        }
+
+        RingDeque(RingDeque &&old) noexcept : allocator_(old.allocator_), data_(nullptr), capacity_(0), mask_(0),
+                                              begin_(0), size_(0) {
+            swapStorage(old);
+        }
+
+        ~RingDeque() {
+            release();
+        }
+
+        RingDeque &operator=(const RingDeque &right) {
+            if (&right == this)
+                return *this;
+
+            if constexpr (AllocatorTraits::propagate_on_container_copy_assignment::value) {
+                if (allocator_ != right.allocator_)
+                    release();
+
+                allocator_ = right.allocator_;
+            }
+
+            RingDeque copy(right.capacity_, allocator_);
+
+            for (size_t i = 0; i < right.size_; ++i)
+                copy.push_back(right[i]);
+
+            swapStorage(copy);
+
+            return *this;
+        }
+
+        RingDeque &operator=(RingDeque &&right) {
+            if (&right == this)
+                return *this;
+
+            if constexpr (AllocatorTraits::propagate_on_container_move_assignment::value) {
+                release();
+                allocator_ = right.allocator_;
+                swapStorage(right);
+            } else if (allocator_ != right.allocator_) {
+                RingDeque copy(right.capacity_, allocator_);
+
+                for (size_t i = 0; i < right.size_; ++i)
+                    copy.push_back(std::move(right[i]));
+
+                swapStorage(copy);
+                right.clear();
+            } else {
+                release();
+                swapStorage(right);
+            }
+
+            return *this;
+        }
+
+        void swap(RingDeque &other) {
+            if constexpr (AllocatorTraits::propagate_on_container_swap::value) {
+                using std::swap;
+                swap(allocator_, other.allocator_);
+            }
+
+            swapStorage(other);
+        }
+
+        allocator_type get_allocator() const {
+            return allocator_;
+        }
+
+        void clear() {
+            if (!std::is_trivially_destructible <T>::value) {
+                for (size_t i = 0; i < size_; ++i)
+                    destroy(begin_ + i);
+            }
+
+            begin_ = size_ = 0;
+        }
+
+        size_t capacity() const {
+            return capacity_;
+        }
+
+        inline size_t size() const {
+            return size_;
+        }
+
+        bool empty() const {
+            return size_ == 0;
+        }
+
+        bool full() const {
+            return size_ == capacity_;
+        }
+
+        template <typename... Args>
+        T &emplace_back(Args &&... args) {
+            if (size_ == capacity_) {
+                if (!OverflowPolicy::kOverwrite || !capacity_)
+                    throw Errors::DE_FULL;
+
+                return overwrite <true>(std::forward<Args>(args)...);
+            }
+
+            T *element = slot(begin_ + size_);
+
+            AllocatorTraits::construct(allocator_, element, std::forward<Args>(args)...);
+            ++size_;
+
+            return *element;
+        }
+
+        template <typename... Args>
+        T &emplace_front(Args &&... args) {
+            if (size_ == capacity_) {
+                if (!OverflowPolicy::kOverwrite || !capacity_)
+                    throw Errors::DE_FULL;
+
+                return overwrite <false>(std::forward<Args>(args)...);
+            }
+
+            T *element = slot(begin_ - 1);
+
+            AllocatorTraits::construct(allocator_, element, std::forward<Args>(args)...);
+            --begin_;
+            ++size_;
+
+            return *element;
+        }
+
+        void push_back(const T &element) {
+            emplace_back(element);
+        }
+
+        void push_back(T &&element) {
+            emplace_back(std::move(element));
+        }
+
+        void push_front(const T &element) {
+            emplace_front(element);
+        }
+
+        void push_front(T &&element) {
+            emplace_front(std::move(element));
+        }
+
+        // the non-throwing way to push with RejectOnOverflow, returns false when the deque is full
+        template <typename U>
+        bool try_push_back(U &&element) {
+            if (size_ == capacity_ && !OverflowPolicy::kOverwrite)
+                return false;
+
+            emplace_back(std::forward<U>(element));
+            return true;
+        }
+
+        template <typename U>
+        bool try_push_front(U &&element) {
+            if (size_ == capacity_ && !OverflowPolicy::kOverwrite)
+                return false;
+
+            emplace_front(std::forward<U>(element));
+            return true;
+        }
+
+        void pop_front() {
+            CheckingPolicy::require(!empty(), Errors::DE_EMPTY);
+
+            destroy(begin_++);
+            --size_;
+        }
+
+        void pop_back() {
+            CheckingPolicy::require(!empty(), Errors::DE_EMPTY);
+
+            destroy(begin_ + --size_);
+        }
+
+        T &front() {
+            CheckingPolicy::require(!empty(), Errors::DE_EMPTY);
+            return *slot(begin_);
+        }
+
+        const T &front() const {
+            CheckingPolicy::require(!empty(), Errors::DE_EMPTY);
+            return *slot(begin_);
+        }
+
+        T &back() {
+            CheckingPolicy::require(!empty(), Errors::DE_EMPTY);
+            return *slot(begin_ + size_ - 1);
+        }
+
+        const T &back() const {
+            CheckingPolicy::require(!empty(), Errors::DE_EMPTY);
+            return *slot(begin_ + size_ - 1);
+        }
+
+        const T &operator[](size_t index) const {
+            if constexpr (CheckingPolicy::kCheckIndex)
+                CheckingPolicy::require(index < size_, Errors::DE_OUT_OF_RANGE);
+
+            return *slot(begin_ + index);
+        }
+
+        T &operator[](size_t index) {
+            if constexpr (CheckingPolicy::kCheckIndex)
+                CheckingPolicy::require(index < size_, Errors::DE_OUT_OF_RANGE);
+
+            return *slot(begin_ + index);
+        }
+
+        const T &at(size_t index) const {
+            if (index >= size_)
+                throw Errors::DE_OUT_OF_RANGE;
+
+            return *slot(begin_ + index);
+        }
+
+        T &at(size_t index) {
+            if (index >= size_)
+                throw Errors::DE_OUT_OF_RANGE;
+
+            return *slot(begin_ + index);
+        }
+
+        // the elements as at most two contiguous runs, returns how many were filled
+        size_t readable_spans(Span <const T> *spans, size_t max_spans) const {
+            size_t count = 0;
+            size_t first = std::min(size_, mask_ + 1 - (begin_ & mask_));
+
+            if (size_ && count < max_spans)
+                spans[count++] = Span <const T>{slot(begin_), first};
+            if (size_ > first && count < max_spans)
+                spans[count++] = Span <const T>{data_, size_ - first};
+
+            return count;
+        }
+
+        iterator begin() {
+            return iterator(0, this);
+        }
+
+        const_iterator cbegin() const {
+            return const_iterator(0, this);
+        }
+
+        const_iterator begin() const {
+            return cbegin();
+        }
+
+        iterator end() {
+            return iterator(size(), this);
+        }
+
+        const_iterator cend() const {
+            return const_iterator(size(), this);
+        }
+
+        const_iterator end() const {
+            return cend();
+        }
+
+        reverse_iterator rbegin() {
+            return reverse_iterator(end());
+        }
+
+        const_reverse_iterator crbegin() const {
+            return const_reverse_iterator(cend());
+        }
+
+        const_reverse_iterator rbegin() const {
+            return crbegin();
+        }
+
+        reverse_iterator rend() {
+            return reverse_iterator(begin());
+        }
+
+        const_reverse_iterator crend() const {
+            return const_reverse_iterator(cbegin());
+        }
+
+        const_reverse_iterator rend() const {
+            return crend();
+        }
+    };
+}
+
+#endif //RING_DEQUE_H
@@ -0,0 +1,584 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#ifndef SHARED_DEQUE_H
+#define SHARED_DEQUE_H
+
+#include <atomic>
+
+#include "deque.h"
+
+// A deque whose copies share storage. The elements live in reference-counted blocks listed by a
+// reference-counted map, so a copy only bumps the map's count. The first write through a copy clones the
+// map (one pointer per block) and then the block it touches, so a writer pays per block it modifies,
+// never for the whole deque. Copies sharing storage may be used from different threads, like copies of a
+// shared_ptr; a single SharedDeque may not.
+//
+// A block's constructed slots [lo, hi) cover every view's part of it. Pops through a view that does not own
+// the block only move the view, the element stays until the block is owned again or released.
+namespace Deque {
+    template <typename T, typename Allocator = std::allocator <T>, typename CheckingPolicy = DEQUE_CHECKING_POLICY>
+    class SharedDeque {
+    private:
+        static constexpr size_t blockSize() {
+            size_t size = 16;
+
+            while (2 * size * sizeof(T) <= 4096)
+                size *= 2;
+
+            return size;
+        }
+
+        static constexpr size_t kBlockSize = blockSize();
+        static constexpr size_t kBlockMask = kBlockSize - 1;
+
+        struct Block {
+            std::atomic <size_t> refs;
+            size_t lo;
+            size_t hi;
+            T *slots;
+        };
+
+        typedef std::allocator_traits <Allocator> AllocatorTraits;
+        typedef typename AllocatorTraits::template rebind_alloc <Block> BlockAllocator;
+        typedef typename AllocatorTraits::template rebind_alloc <Block *> BlockPointerAllocator;
+
+        struct Map {
+            std::atomic <size_t> refs;
+            // block i holds positions [i * kBlockSize, (i + 1) * kBlockSize)
+            Deque <Block *, BlockPointerAllocator> blocks;
+
+            explicit Map(const Allocator &allocator) : refs(1), blocks(BlockPointerAllocator(allocator)) {}
+        };
+
+        typedef typename AllocatorTraits::template rebind_alloc <Map> MapAllocator;
+
+        Allocator allocator_;
+        // the blocks cover exactly the positions [offset_, offset_ + size_), offset_ lies in the first block
+        Map *map_;
+        size_t offset_;
+        size_t size_;
+
+        Block *newBlock(size_t slot) {
+            BlockAllocator allocator(allocator_);
+            Block *block = std::allocator_traits <BlockAllocator>::allocate(allocator, 1);
+
+            try {
+                block->slots = AllocatorTraits::allocate(allocator_, kBlockSize);
+            } catch (...) {
+                std::allocator_traits <BlockAllocator>::deallocate(allocator, block, 1);
+                throw;
+            }
+
+            ::new (static_cast<void *>(&block->refs)) std::atomic <size_t>(1);
+            block->lo = block->hi = slot;
+
+            return block;
+        }
+
+        void releaseBlock(Block *block) {
+            if (block->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+
+            for (size_t i = block->lo; i < block->hi; ++i)
+                AllocatorTraits::destroy(allocator_, block->slots + i);
+
+            AllocatorTraits::deallocate(allocator_, block->slots, kBlockSize);
+
+            BlockAllocator allocator(allocator_);
+            std::allocator_traits <BlockAllocator>::deallocate(allocator, block, 1);
+        }
+
+        Map *newMap() {
+            MapAllocator allocator(allocator_);
+            Map *map = std::allocator_traits <MapAllocator>::allocate(allocator, 1);
+
+            ::new (static_cast<void *>(map)) Map(allocator_);
+            return map;
+        }
+
+        void releaseMap(Map *map) {
+            if (!map || map->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+
+            for (Block *block : map->blocks)
+                releaseBlock(block);
+
+            MapAllocator allocator(allocator_);
+
+            map->~Map();
+            std::allocator_traits <MapAllocator>::deallocate(allocator, map, 1);
+        }
+
+        bool exclusive(const Block *block) const {
+            return map_->refs.load(std::memory_order_acquire) == 1 && block->refs.load(std::memory_order_acquire) == 1;
+        }
+
+        // makes the map this view's own, sharing the blocks
+        void ownMap() {
+            if (!map_) {
+                map_ = newMap();
+                return;
+            }
+
+            if (map_->refs.load(std::memory_order_acquire) == 1)
+                return;
+
+            Map *copy = newMap();
+
+            try {
+                copy->blocks.reserve(map_->blocks.size());
+
+                for (Block *block : map_->blocks) {
+                    copy->blocks.push_back(block);
+                    block->refs.fetch_add(1, std::memory_order_relaxed);
+                }
+            } catch (...) {
+                releaseMap(copy);
+                throw;
+            }
+
+            releaseMap(map_);
+            map_ = copy;
+        }
+
+        // makes block `number` this view's own, cloning it if it is shared, and trims its constructed slots
+        // to this view's part of it
+        Block *ownBlock(size_t number) {
+            ownMap();
+
+            Block *&block = map_->blocks[number];
+            size_t lo = number ? 0 : offset_;
+            size_t hi = std::min(kBlockSize, offset_ + size_ - number * kBlockSize);
+
+            if (block->refs.load(std::memory_order_acquire) != 1) {
+                Block *copy = newBlock(lo);
+
+                try {
+                    for (; copy->hi < hi; ++copy->hi)
+                        AllocatorTraits::construct(allocator_, copy->slots + copy->hi, block->slots[copy->hi]);
+                } catch (...) {
+                    releaseBlock(copy);
+                    throw;
+                }
+
+                releaseBlock(block);
+                block = copy;
+            } else {
+                for (; block->lo < lo; ++block->lo)
+                    AllocatorTraits::destroy(allocator_, block->slots + block->lo);
+                for (; block->hi > hi; --block->hi)
+                    AllocatorTraits::destroy(allocator_, block->slots + block->hi - 1);
+            }
+
+            return block;
+        }
+
+        T *slot(size_t position) const {
+            return map_->blocks[position / kBlockSize]->slots + (position & kBlockMask);
+        }
+
+        Block *backBlockForPush() {
+            size_t end = offset_ + size_;
+
+            if (size_ && (end & kBlockMask))
+                return ownBlock(map_->blocks.size() - 1);
+
+            ownMap();
+
+            Block *block = newBlock(end & kBlockMask);
+
+            try {
+                map_->blocks.push_back(block);
+            } catch (...) {
+                releaseBlock(block);
+                throw;
+            }
+
+            return block;
+        }
+
+        // a new front block is filled from its end, so positions shift by a whole block
+        Block *frontBlockForPush() {
+            if (size_ && offset_)
+                return ownBlock(0);
+
+            ownMap();
+
+            Block *block = newBlock(kBlockSize);
+
+            try {
+                map_->blocks.push_front(block);
+            } catch (...) {
+                releaseBlock(block);
+                throw;
+            }
+
+            offset_ += kBlockSize;
+            return block;
+        }
+
+        void swapStorage(SharedDeque &other) noexcept {
+            std::swap(map_, other.map_);
+            std::swap(offset_, other.offset_);
+            std::swap(size_, other.size_);
+        }
+
+        // takes on right's map and blocks, which this view's allocator must be able to release
+        void share(const SharedDeque &right) {
+            if (right.map_)
+                right.map_->refs.fetch_add(1, std::memory_order_relaxed);
+
+            releaseMap(map_);
+            map_ = right.map_;
+            offset_ = right.offset_;
+            size_ = right.size_;
+        }
+
+        void copyElements(const SharedDeque &right) {
+            SharedDeque copy(allocator_);
+
+            for (const T &element : right)
+                copy.push_back(element);
+
+            swapStorage(copy);
+        }
+
+        template <typename, typename, typename, typename, typename, typename>
+        friend class DequeIterator;
+
+        T *iteratorSegment(long long index, T *&first, T *&last) const {
+            if (index < 0 || index >= static_cast<long long>(size_)) {
+                first = last = nullptr;
+                return nullptr;
+            }
+
+            size_t position = offset_ + static_cast<size_t>(index);
+
+            first = map_->blocks[position / kBlockSize]->slots;
+            last = first + kBlockSize;
+
+            return first + (position & kBlockMask);
+        }
+
+    public:
+        typedef typename Deque <T, Allocator, DefaultGrowthPolicy, CheckingPolicy>::Errors Errors;
+
+        typedef T value_type;
+        typedef Allocator allocator_type;
+        typedef CheckingPolicy checking_policy;
+        typedef size_t size_type;
+        typedef T &reference;
+        typedef const T &const_reference;
+
+        // iteration is read-only, writes go through operator[], front() and back() so they can unshare
+        typedef DequeIterator <const SharedDeque, std::random_access_iterator_tag, T, long long, const T *, const T &>
+                const_iterator;
+        typedef const_iterator iterator;
+        typedef std::reverse_iterator <const_iterator> const_reverse_iterator;
+        typedef const_reverse_iterator reverse_iterator;
+
+        SharedDeque() : SharedDeque(Allocator()) {}
+
+        explicit SharedDeque(const Allocator &allocator) noexcept : allocator_(allocator), map_(nullptr), offset_(0),
+                                                                    size_(0) {}
+
+        // O(1): the copy shares the map and the blocks
+        SharedDeque(const SharedDeque &old) : allocator_(old.allocator_), map_(old.map_), offset_(old.offset_),
+                                              size_(old.size_) {
+            if (map_)
+                map_->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        SharedDeque(SharedDeque &&old) noexcept : allocator_(old.allocator_), map_(old.map_), offset_(old.offset_),
+                                                  size_(old.size_) {
+            old.map_ = nullptr;
+            old.offset_ = old.size_ = 0;
+        }
+
+        ~SharedDeque() {
+            releaseMap(map_);
+        }
+
+        // Views only share blocks under equal allocators. An allocator that does not propagate stays with the
+        // target, which then copies right's elements into blocks of its own if the allocators differ.
+        SharedDeque &operator=(const SharedDeque &right) {
+            if (&right == this)
+                return *this;
+
+            if constexpr (AllocatorTraits::propagate_on_container_copy_assignment::value) {
+                clear();
+                allocator_ = right.allocator_;
+                share(right);
+            } else if (allocator_ == right.allocator_) {
+                share(right);
+            } else {
+                copyElements(right);
+            }
+
+            return *this;
+        }
+
+        // right's elements may be shared with other views, so a move between unequal allocators copies them
+        SharedDeque &operator=(SharedDeque &&right) {
+            if (&right == this)
+                return *this;
+
+            if constexpr (AllocatorTraits::propagate_on_container_move_assignment::value) {
+                clear();
+                allocator_ = right.allocator_;
+                swapStorage(right);
+            } else if (allocator_ == right.allocator_) {
+                clear();
+                swapStorage(right);
+            } else {
+                copyElements(right);
+                right.clear();
+            }
+
+            return *this;
+        }
+
+        void swap(SharedDeque &other) noexcept {
+            if constexpr (AllocatorTraits::propagate_on_container_swap::value) {
+                using std::swap;
+                swap(allocator_, other.allocator_);
+            }
+
+            swapStorage(other);
+        }
+
+        SharedDeque snapshot() const {
+            return *this;
+        }
+
+        allocator_type get_allocator() const {
+            return allocator_;
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+        bool empty() const {
+            return size_ == 0;
+        }
+
+        void clear() {
+            releaseMap(map_);
+            map_ = nullptr;
+            offset_ = size_ = 0;
+        }
+
+        template <typename... Args>
+        T &emplace_back(Args &&... args) {
+            size_t slot = (offset_ + size_) & kBlockMask;
+
+            if (size_ && slot) {
+                Block *block = map_->blocks.back();
+
+                if (exclusive(block) && block->hi == slot) {
+                    AllocatorTraits::construct(allocator_, block->slots + slot, std::forward<Args>(args)...);
+                    ++block->hi;
+                    ++size_;
+
+                    return block->slots[slot];
+                }
+            }
+
+            // unsharing may release the block args refer to
+            T element(std::forward<Args>(args)...);
+            Block *block = backBlockForPush();
+
+            AllocatorTraits::construct(allocator_, block->slots + block->hi, std::move(element));
+            ++size_;
+
+            return block->slots[block->hi++];
+        }
+
+        template <typename... Args>
+        T &emplace_front(Args &&... args) {
+            if (size_ && offset_) {
+                Block *block = map_->blocks.front();
+
+                if (exclusive(block) && block->lo == offset_) {
+                    AllocatorTraits::construct(allocator_, block->slots + offset_ - 1, std::forward<Args>(args)...);
+                    block->lo = --offset_;
+                    ++size_;
+
+                    return block->slots[offset_];
+                }
+            }
+
+            T element(std::forward<Args>(args)...);
+            Block *block = frontBlockForPush();
+
+            AllocatorTraits::construct(allocator_, block->slots + block->lo - 1, std::move(element));
+            --block->lo;
+            offset_ = block->lo;
+            ++size_;
+
+            return block->slots[offset_];
+        }
+
+        void push_back(const T &element) {
+            emplace_back(element);
+        }
+
+        void push_back(T &&element) {
+            emplace_back(std::move(element));
+        }
+
+        void push_front(const T &element) {
+            emplace_front(element);
+        }
+
+        void push_front(T &&element) {
+            emplace_front(std::move(element));
+        }
+
+        void pop_back() {
+            CheckingPolicy::require(size_ != 0, Errors::DE_EMPTY);
+
+            if (size_ == 1) {
+                clear();
+                return;
+            }
+
+            size_t slot = (offset_ + --size_) & kBlockMask;
+            Block *block = map_->blocks.back();
+
+            if (exclusive(block))
+                for (; block->hi > slot; --block->hi)
+                    AllocatorTraits::destroy(allocator_, block->slots + block->hi - 1);
+
+            if (slot == 0) {
+                ownMap();
+                releaseBlock(map_->blocks.back());
+                map_->blocks.pop_back();
+            }
+        }
+
+        void pop_front() {
+            CheckingPolicy::require(size_ != 0, Errors::DE_EMPTY);
+
+            if (size_ == 1) {
+                clear();
+                return;
+            }
+
+            Block *block = map_->blocks.front();
+
+            if (exclusive(block))
+                for (; block->lo <= offset_; ++block->lo)
+                    AllocatorTraits::destroy(allocator_, block->slots + block->lo);
+
+            --size_;
+
+            if (++offset_ == kBlockSize) {
+                ownMap();
+                releaseBlock(map_->blocks.front());
+                map_->blocks.pop_front();
+                offset_ = 0;
+            }
+        }
+
+        const T &operator[](size_t index) const {
+            if constexpr (CheckingPolicy::kCheckIndex)
+                CheckingPolicy::require(index < size_, Errors::DE_OUT_OF_RANGE);
+
+            return *slot(offset_ + index);
+        }
+
+        // unshares the block holding the element
+        T &operator[](size_t index) {
+            if constexpr (CheckingPolicy::kCheckIndex)
+                CheckingPolicy::require(index < size_, Errors::DE_OUT_OF_RANGE);
+
+            size_t position = offset_ + index;
+
+            return ownBlock(position / kBlockSize)->slots[position & kBlockMask];
+        }
+
+        const T &at(size_t index) const {
+            if (index >= size_)
+                throw Errors::DE_OUT_OF_RANGE;
+
+            return operator[](index);
+        }
+
+        T &at(size_t index) {
+            if (index >= size_)
+                throw Errors::DE_OUT_OF_RANGE;
+
+            return operator[](index);
+        }
+
+        const T &front() const {
+            CheckingPolicy::require(size_ != 0, Errors::DE_EMPTY);
+            return operator[](0);
+        }
+
+        T &front() {
+            CheckingPolicy::require(size_ != 0, Errors::DE_EMPTY);
+            return operator[](0);
+        }
+
+        const T &back() const {
+            CheckingPolicy::require(size_ != 0, Errors::DE_EMPTY);
+            return operator[](size_ - 1);
+        }
+
+        T &back() {
+            CheckingPolicy::require(size_ != 0, Errors::DE_EMPTY);
+            return operator[](size_ - 1);
+        }
+
+        const_iterator begin() const {
+            return const_iterator(0, this);
+        }
+
+        const_iterator cbegin() const {
+            return begin();
+        }
+
+        const_iterator end() const {
+            return const_iterator(size_, this);
+        }
+
+        const_iterator cend() const {
+            return end();
+        }
+
+        const_reverse_iterator rbegin() const {
+            return const_reverse_iterator(end());
+        }
+
+        const_reverse_iterator crbegin() const {
+            return rbegin();
+        }
+
+        const_reverse_iterator rend() const {
+            return const_reverse_iterator(begin());
+        }
+
+        const_reverse_iterator crend() const {
+            return rend();
+        }
+    };
+}
+
+#endif //SHARED_DEQUE_H
@@ -0,0 +1,226 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#ifndef SLIDING_WINDOW_H
+#define SLIDING_WINDOW_H
+
+#include <functional>
+#include <optional>
+
+#include "deque.h"
+
+// Rolling aggregates over a stream: the window holds the items pushed and not yet evicted, and value() is
+// Op folded over them, oldest first. Items carry non-decreasing keys (a sequence number by default, or
+// e.g. timestamps), so the window can be cut by count, pop_n()/keep_last(), or by key, evict_before().
+// Push, evict and value() are O(1) amortized whatever the window size.
+//
+// An Op with a compare_type, like MinOf and MaxOf, is a selection and is kept as a monotonic queue: only the
+// items no later item beats are stored. Any other associative Op, std::plus <T> for a rolling sum say, uses
+// two-stack aggregation: the older part of the window holds suffix aggregates, the newer part the values
+// and their running aggregate, and the newer part is folded into the older one when that runs out.
+namespace Deque {
+    template <typename T>
+    struct MinOf {
+        typedef std::less <T> compare_type;
+
+        const T &operator()(const T &left, const T &right) const {
+            return right < left ? right : left;
+        }
+    };
+
+    template <typename T>
+    struct MaxOf {
+        typedef std::greater <T> compare_type;
+
+        const T &operator()(const T &left, const T &right) const {
+            return left < right ? right : left;
+        }
+    };
+
+    namespace detail {
+        template <typename Op, typename = void>
+        struct IsSelection : std::false_type {};
+
+        template <typename Op>
+        struct IsSelection <Op, std::void_t <typename Op::compare_type>> : std::true_type {};
+    }
+
+    template <typename T, typename Op, typename Key = size_t, typename CheckingPolicy = DEQUE_CHECKING_POLICY>
+    class SlidingWindow {
+    private:
+        static constexpr bool kSelection = detail::IsSelection <Op>::value;
+
+        // the window checks its own preconditions, its storage runs unchecked
+        template <typename Element>
+        using Storage = Deque <Element, std::allocator <Element>, DefaultGrowthPolicy, NoChecks>;
+
+        struct Candidate {
+            size_t sequence;
+            T value;
+        };
+
+        Op op_;
+        Storage <Key> keys_;
+        size_t front_sequence_;  // sequence number of the oldest item
+        size_t next_sequence_;
+
+        // selections: in sequence order, each candidate beats every later one
+        Storage <Candidate> candidates_;
+
+        // everything else: aggregates of the older items from each one to the last older item, and the values
+        // of the newer items with their aggregate
+        Storage <T> front_aggregates_;
+        Storage <T> back_values_;
+        std::optional <T> back_aggregate_;
+
+        void moveBackToFront() {
+            for (size_t i = back_values_.size(); i-- > 0;) {
+                if (front_aggregates_.empty())
+                    front_aggregates_.push_front(back_values_[i]);
+                else
+                    front_aggregates_.push_front(op_(back_values_[i], front_aggregates_.front()));
+            }
+
+            back_values_.clear();
+            back_aggregate_.reset();
+        }
+
+    public:
+        enum class Errors {
+            DE_EMPTY,
+            DE_OUT_OF_RANGE
+        };
+
+        typedef T value_type;
+        typedef Key key_type;
+        typedef Op operation_type;
+        typedef CheckingPolicy checking_policy;
+        typedef size_t size_type;
+
+        explicit SlidingWindow(const Op &op = Op()) : op_(op), front_sequence_(0), next_sequence_(0) {}
+
+        size_t size() const {
+            return keys_.size();
+        }
+
+        bool empty() const {
+            return keys_.empty();
+        }
+
+        // Op over the items in the window, oldest first; DE_EMPTY if there are none
+        T value() const {
+            CheckingPolicy::require(!empty(), Errors::DE_EMPTY);
+
+            if constexpr (kSelection) {
+                return candidates_.front().value;
+            } else {
+                if (front_aggregates_.empty())
+                    return *back_aggregate_;
+
+                if (!back_aggregate_)
+                    return front_aggregates_.front();
+
+                return op_(front_aggregates_.front(), *back_aggregate_);
+            }
+        }
+
+        const Key &front_key() const {
+            CheckingPolicy::require(!empty(), Errors::DE_EMPTY);
+            return keys_.front();
+        }
+
+        const Key &back_key() const {
+            CheckingPolicy::require(!empty(), Errors::DE_EMPTY);
+            return keys_.back();
+        }
+
+        // keys must not decrease, DE_OUT_OF_RANGE otherwise
+        void push(const Key &key, const T &value) {
+            CheckingPolicy::require(keys_.empty() || !(key < keys_.back()), Errors::DE_OUT_OF_RANGE);
+
+            if constexpr (kSelection) {
+                typename Op::compare_type beats;
+
+                while (!candidates_.empty() && !beats(candidates_.back().value, value))
+                    candidates_.pop_back();
+
+                candidates_.push_back(Candidate{next_sequence_, value});
+            } else {
+                back_aggregate_ = back_aggregate_ ? op_(*back_aggregate_, value) : value;
+                back_values_.push_back(value);
+            }
+
+            keys_.push_back(key);
+            ++next_sequence_;
+        }
+
+        // keyed by the number of items pushed before it
+        void push(const T &value) {
+            push(static_cast<Key>(next_sequence_), value);
+        }
+
+        void pop() {
+            pop_n(1);
+        }
+
+        // evicts the n oldest items, DE_OUT_OF_RANGE if there are fewer
+        void pop_n(size_t n) {
+            CheckingPolicy::require(n <= size(), Errors::DE_OUT_OF_RANGE);
+
+            if (!n)
+                return;
+
+            keys_.pop_front_n(n);
+            front_sequence_ += n;
+
+            if constexpr (kSelection) {
+                while (!candidates_.empty() && candidates_.front().sequence < front_sequence_)
+                    candidates_.pop_front();
+            } else {
+                size_t older = std::min(n, front_aggregates_.size());
+                front_aggregates_.pop_front_n(older);
+
+                if (n > older) {
+                    back_values_.pop_front_n(n - older);
+                    moveBackToFront();
+                }
+            }
+        }
+
+        // evicts the oldest items until at most n are left
+        void keep_last(size_t n) {
+            if (size() > n)
+                pop_n(size() - n);
+        }
+
+        // evicts every item keyed below `bound` and returns how many there were
+        size_t evict_before(const Key &bound) {
+            size_t count = 0;
+
+            while (count < keys_.size() && keys_[count] < bound)
+                ++count;
+
+            pop_n(count);
+            return count;
+        }
+
+        void clear() {
+            pop_n(size());
+        }
+    };
+}
+
+#endif //SLIDING_WINDOW_H
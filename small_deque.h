@@ -0,0 +1,422 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#ifndef SMALL_DEQUE_H
+#define SMALL_DEQUE_H
+
+#include "deque.h"
+
+namespace Deque {
+    // A deque that keeps up to N elements in a ring inside the object and only moves them into a heap Deque
+    // when the N + 1st arrives. Once the heap part empties it switches back to the inline ring. That frees
+    // the heap deque's blocks but keeps its block map for the next spill; shrink_to_fit() gives the map back.
+    template <typename T, size_t N, typename Allocator = std::allocator <T>,
+              typename CheckingPolicy = DEQUE_CHECKING_POLICY>
+    class SmallDeque {
+    private:
+        static_assert(N > 0, "a SmallDeque needs room for at least one inline element");
+
+        typedef Deque <T, Allocator, DefaultGrowthPolicy, CheckingPolicy> HeapDeque;
+
+        HeapDeque heap_;
+        bool spilled_;
+        // inline elements occupy ring slots begin_, begin_ + 1, ... modulo N
+        size_t begin_;
+        size_t size_;
+        alignas(T) unsigned char storage_[N * sizeof(T)];
+
+        // position is at most 2 * N - 1
+        T *inlineSlot(size_t position) const {
+            return reinterpret_cast<T *>(const_cast<unsigned char *>(storage_)) + (position < N ? position : position - N);
+        }
+
+        void destroyInline() {
+            for (size_t i = 0; i < size_; ++i)
+                inlineSlot(begin_ + i)->~T();
+
+            begin_ = size_ = 0;
+        }
+
+        // moves the inline elements to the heap deque
+        void spill() {
+            heap_.reserve(2 * N);
+
+            try {
+                for (size_t i = 0; i < size_; ++i)
+                    heap_.emplace_back(std::move_if_noexcept(*inlineSlot(begin_ + i)));
+            } catch (...) {
+                heap_.clear();
+                throw;
+            }
+
+            destroyInline();
+            spilled_ = true;
+        }
+
+        // moves the heap elements back inline, only called when they fit; if a copy throws, the inline copies
+        // made so far are destroyed and the heap deque still holds everything
+        void unspill() {
+            size_t moved = 0;
+
+            try {
+                for (; moved < heap_.size(); ++moved)
+                    ::new (static_cast<void *>(inlineSlot(moved))) T(std::move_if_noexcept(heap_[moved]));
+            } catch (...) {
+                for (size_t i = 0; i < moved; ++i)
+                    inlineSlot(i)->~T();
+
+                throw;
+            }
+
+            begin_ = 0;
+            size_ = moved;
+            heap_.clear();
+            spilled_ = false;
+        }
+
+        template <typename, typename, typename, typename, typename, typename>
+        friend class DequeIterator;
+
+        // for iterators: the whole inline ring is one segment, the heap deque has its blocks
+        T *iteratorSegment(long long index, T *&first, T *&last) const {
+            if (spilled_)
+                return heap_.iteratorSegment(index, first, last);
+
+            first = inlineSlot(0);
+            last = first + N;
+
+            return first + static_cast<size_t>(static_cast<long long>(begin_ + N) + index) % N;
+        }
+
+    public:
+        typedef typename HeapDeque::Errors Errors;
+
+        typedef T value_type;
+        typedef Allocator allocator_type;
+        typedef CheckingPolicy checking_policy;
+        typedef size_t size_type;
+        typedef T &reference;
+        typedef const T &const_reference;
+
+        typedef DequeIterator <SmallDeque, std::random_access_iterator_tag, T, long long, T *, T &> iterator;
+        typedef DequeIterator <const SmallDeque, std::random_access_iterator_tag, T, long long, const T *, const T &>
+                const_iterator;
+        typedef std::reverse_iterator <iterator> reverse_iterator;
+        typedef std::reverse_iterator <const_iterator> const_reverse_iterator;
+
+        SmallDeque() : SmallDeque(Allocator()) {}
+
+        explicit SmallDeque(const Allocator &allocator) noexcept : heap_(allocator), spilled_(false), begin_(0),
+                                                                   size_(0) {}
+
+        SmallDeque(const SmallDeque &old) : SmallDeque(std::allocator_traits <Allocator>::
+                                                       select_on_container_copy_construction(old.get_allocator())) {
+            for (size_t i = 0; i < old.size(); ++i)
+                push_back(old[i]);
+        }
+
+        SmallDeque(SmallDeque &&old) noexcept(std::is_nothrow_move_constructible <T>::value) :
+                SmallDeque(old.get_allocator()) {
+            if (old.spilled_) {
+                heap_.swap(old.heap_);
+                spilled_ = true;
+                old.spilled_ = false;
+                return;
+            }
+
+            for (; size_ < old.size_; ++size_)
+                ::new (static_cast<void *>(inlineSlot(size_))) T(std::move(*old.inlineSlot(old.begin_ + size_)));
+
+            old.destroyInline();
+        }
+
+        ~SmallDeque() {
+            destroyInline();
+        }
+
+        SmallDeque &operator=(const SmallDeque &right) {
+            if (&right == this)
+                return *this;
+
+            clear();
+
+            // the heap deque's copy assignment takes right's allocator when the traits say to propagate it, and
+            // brings right's heap elements along; inline ones are copied after
+            heap_ = right.heap_;
+            spilled_ = right.spilled_;
+
+            if (!spilled_) {
+                for (size_t i = 0; i < right.size_; ++i)
+                    push_back(right[i]);
+            }
+
+            return *this;
+        }
+
+        SmallDeque &operator=(SmallDeque &&right) {
+            if (&right == this)
+                return *this;
+
+            clear();
+
+            if (right.spilled_) {
+                heap_ = std::move(right.heap_);
+                spilled_ = true;
+                right.spilled_ = false;
+                return *this;
+            }
+
+            // right's heap deque is empty, moving it only brings the allocator along when the traits say to
+            if constexpr (std::allocator_traits <Allocator>::propagate_on_container_move_assignment::value)
+                heap_ = std::move(right.heap_);
+
+            for (; size_ < right.size_; ++size_)
+                ::new (static_cast<void *>(inlineSlot(size_))) T(std::move(*right.inlineSlot(right.begin_ + size_)));
+
+            right.destroyInline();
+
+            return *this;
+        }
+
+        allocator_type get_allocator() const {
+            return heap_.get_allocator();
+        }
+
+        static constexpr size_t inline_capacity() {
+            return N;
+        }
+
+        // whether the elements currently live on the heap
+        bool spilled() const {
+            return spilled_;
+        }
+
+        size_t size() const {
+            return spilled_ ? heap_.size() : size_;
+        }
+
+        bool empty() const {
+            return size() == 0;
+        }
+
+        void clear() {
+            destroyInline();
+            heap_.clear();
+            spilled_ = false;
+        }
+
+        // returns to inline storage if the elements fit and frees whatever heap storage is left
+        void shrink_to_fit() {
+            if (spilled_ && heap_.size() <= N)
+                unspill();
+
+            heap_.shrink_to_fit();
+        }
+
+        template <typename... Args>
+        T &emplace_back(Args &&... args) {
+            if (spilled_)
+                return heap_.emplace_back(std::forward<Args>(args)...);
+
+            if (size_ == N) {
+                // args may refer to an element that spill() is about to move
+                T element(std::forward<Args>(args)...);
+
+                spill();
+                return heap_.emplace_back(std::move(element));
+            }
+
+            T *constructed = ::new (static_cast<void *>(inlineSlot(begin_ + size_))) T(std::forward<Args>(args)...);
+            ++size_;
+
+            return *constructed;
+        }
+
+        template <typename... Args>
+        T &emplace_front(Args &&... args) {
+            if (spilled_)
+                return heap_.emplace_front(std::forward<Args>(args)...);
+
+            if (size_ == N) {
+                T element(std::forward<Args>(args)...);
+
+                spill();
+                return heap_.emplace_front(std::move(element));
+            }
+
+            size_t first = begin_ ? begin_ - 1 : N - 1;
+            T *constructed = ::new (static_cast<void *>(inlineSlot(first))) T(std::forward<Args>(args)...);
+
+            begin_ = first;
+            ++size_;
+
+            return *constructed;
+        }
+
+        void push_back(const T &element) {
+            emplace_back(element);
+        }
+
+        void push_back(T &&element) {
+            emplace_back(std::move(element));
+        }
+
+        void push_front(const T &element) {
+            emplace_front(element);
+        }
+
+        void push_front(T &&element) {
+            emplace_front(std::move(element));
+        }
+
+        void pop_front() {
+            if (spilled_) {
+                heap_.pop_front();
+                spilled_ = !heap_.empty();
+                return;
+            }
+
+            CheckingPolicy::require(size_ != 0, Errors::DE_EMPTY);
+
+            inlineSlot(begin_)->~T();
+            begin_ = begin_ + 1 < N ? begin_ + 1 : 0;
+            --size_;
+        }
+
+        void pop_back() {
+            if (spilled_) {
+                heap_.pop_back();
+                spilled_ = !heap_.empty();
+                return;
+            }
+
+            CheckingPolicy::require(size_ != 0, Errors::DE_EMPTY);
+
+            --size_;
+            inlineSlot(begin_ + size_)->~T();
+        }
+
+        T &front() {
+            if (spilled_)
+                return heap_.front();
+
+            CheckingPolicy::require(size_ != 0, Errors::DE_EMPTY);
+            return *inlineSlot(begin_);
+        }
+
+        const T &front() const {
+            if (spilled_)
+                return heap_.front();
+
+            CheckingPolicy::require(size_ != 0, Errors::DE_EMPTY);
+            return *inlineSlot(begin_);
+        }
+
+        T &back() {
+            if (spilled_)
+                return heap_.back();
+
+            CheckingPolicy::require(size_ != 0, Errors::DE_EMPTY);
+            return *inlineSlot(begin_ + size_ - 1);
+        }
+
+        const T &back() const {
+            if (spilled_)
+                return heap_.back();
+
+            CheckingPolicy::require(size_ != 0, Errors::DE_EMPTY);
+            return *inlineSlot(begin_ + size_ - 1);
+        }
+
+        const T &operator[](size_t index) const {
+            if (spilled_)
+                return heap_[index];
+
+            if constexpr (CheckingPolicy::kCheckIndex)
+                CheckingPolicy::require(index < size_, Errors::DE_OUT_OF_RANGE);
+
+            return *inlineSlot(begin_ + index);
+        }
+
+        T &operator[](size_t index) {
+            return const_cast<T &>(static_cast<const SmallDeque &>(*this)[index]);
+        }
+
+        const T &at(size_t index) const {
+            if (index >= size())
+                throw Errors::DE_OUT_OF_RANGE;
+
+            return operator[](index);
+        }
+
+        T &at(size_t index) {
+            if (index >= size())
+                throw Errors::DE_OUT_OF_RANGE;
+
+            return operator[](index);
+        }
+
+        iterator begin() {
+            return iterator(0, this);
+        }
+
+        const_iterator cbegin() const {
+            return const_iterator(0, this);
+        }
+
+        const_iterator begin() const {
+            return cbegin();
+        }
+
+        iterator end() {
+            return iterator(size(), this);
+        }
+
+        const_iterator cend() const {
+            return const_iterator(size(), this);
+        }
+
+        const_iterator end() const {
+            return cend();
+        }
+
+        reverse_iterator rbegin() {
+            return reverse_iterator(end());
+        }
+
+        const_reverse_iterator crbegin() const {
+            return const_reverse_iterator(cend());
+        }
+
+        const_reverse_iterator rbegin() const {
+            return crbegin();
+        }
+
+        reverse_iterator rend() {
+            return reverse_iterator(begin());
+        }
+
+        const_reverse_iterator crend() const {
+            return const_reverse_iterator(cbegin());
+        }
+
+        const_reverse_iterator rend() const {
+            return crend();
+        }
+    };
+}
+
+#endif //SMALL_DEQUE_H
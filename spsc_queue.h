@@ -0,0 +1,413 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+
+#include "deque.h"
+
+// Lock-free queues for exactly one producer thread and one consumer thread. Positions only ever grow:
+// the producer publishes tail with a release store and the consumer publishes head the same way. Each
+// side keeps a cached copy of the other side's position and only reloads it (with an acquire load)
+// when the cached value says the queue is full or empty, so in the steady state neither side touches
+// the other's cache line.
+namespace Deque {
+    // a power-of-two ring of a fixed capacity, pushes fail when it is full
+    template <typename T, typename Allocator = std::allocator <T>>
+    class BoundedSpscQueue {
+    private:
+        typedef std::allocator_traits <Allocator> AllocatorTraits;
+
+        struct alignas(kCacheLineSize) ProducerSide {
+            std::atomic <size_t> tail{0};
+            size_t cached_head = 0;
+        };
+
+        struct alignas(kCacheLineSize) ConsumerSide {
+            std::atomic <size_t> head{0};
+            size_t cached_tail = 0;
+        };
+
+        Allocator allocator_;
+        T *data_;
+        size_t capacity_;
+        size_t mask_;
+
+        ProducerSide producer_;
+        ConsumerSide consumer_;
+
+        T *slot(size_t position) const {
+            return data_ + (position & mask_);
+        }
+
+        // free slots as seen by the producer, refreshing its view of head only if fewer than wanted
+        size_t freeSlots(size_t tail, size_t wanted) {
+            size_t free = capacity_ - (tail - producer_.cached_head);
+
+            if (free < wanted) {
+                producer_.cached_head = consumer_.head.load(std::memory_order_acquire);
+                free = capacity_ - (tail - producer_.cached_head);
+            }
+
+            return free;
+        }
+
+        size_t readySlots(size_t head, size_t wanted) {
+            size_t ready = consumer_.cached_tail - head;
+
+            if (ready < wanted) {
+                consumer_.cached_tail = producer_.tail.load(std::memory_order_acquire);
+                ready = consumer_.cached_tail - head;
+            }
+
+            return ready;
+        }
+
+    public:
+        typedef T value_type;
+
+        explicit BoundedSpscQueue(size_t capacity, const Allocator &allocator = Allocator()) :
+                allocator_(allocator), data_(nullptr), capacity_(capacity), mask_(0) {
+            while (mask_ + 1 < capacity)
+                mask_ = 2 * mask_ + 1;
+
+            data_ = AllocatorTraits::allocate(allocator_, mask_ + 1);
+        }
+
+        BoundedSpscQueue(const BoundedSpscQueue &) = delete;
+        BoundedSpscQueue &operator=(const BoundedSpscQueue &) = delete;
+
+        ~BoundedSpscQueue() {
+            size_t tail = producer_.tail.load(std::memory_order_acquire);
+
+            for (size_t head = consumer_.head.load(std::memory_order_relaxed); head != tail; ++head)
+                AllocatorTraits::destroy(allocator_, slot(head));
+
+            AllocatorTraits::deallocate(allocator_, data_, mask_ + 1);
+        }
+
+        size_t capacity() const {
+            return capacity_;
+        }
+
+        // only exact when neither side is running
+        size_t size_approx() const {
+            return producer_.tail.load(std::memory_order_acquire) - consumer_.head.load(std::memory_order_acquire);
+        }
+
+        // producer side
+
+        template <typename... Args>
+        bool try_emplace(Args &&... args) {
+            size_t tail = producer_.tail.load(std::memory_order_relaxed);
+
+            if (!freeSlots(tail, 1))
+                return false;
+
+            AllocatorTraits::construct(allocator_, slot(tail), std::forward<Args>(args)...);
+            producer_.tail.store(tail + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        bool try_push(const T &element) {
+            return try_emplace(element);
+        }
+
+        bool try_push(T &&element) {
+            return try_emplace(std::move(element));
+        }
+
+        // pushes up to n elements from first with a single publication, returns how many were pushed
+        template <typename Iterator>
+        size_t try_push_n(Iterator first, size_t n) {
+            size_t tail = producer_.tail.load(std::memory_order_relaxed);
+            size_t count = std::min(n, freeSlots(tail, n));
+
+            size_t i = 0;
+
+            try {
+                for (; i < count; ++i, ++first)
+                    AllocatorTraits::construct(allocator_, slot(tail + i), *first);
+            } catch (...) {
+                producer_.tail.store(tail + i, std::memory_order_release);
+                throw;
+            }
+
+            producer_.tail.store(tail + count, std::memory_order_release);
+
+            return count;
+        }
+
+        // consumer side
+
+        bool try_pop(T &element) {
+            size_t head = consumer_.head.load(std::memory_order_relaxed);
+
+            if (!readySlots(head, 1))
+                return false;
+
+            element = std::move(*slot(head));
+            AllocatorTraits::destroy(allocator_, slot(head));
+            consumer_.head.store(head + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        // moves up to n elements to out with a single publication, returns how many were popped
+        template <typename OutputIterator>
+        size_t try_pop_n(OutputIterator out, size_t n) {
+            size_t head = consumer_.head.load(std::memory_order_relaxed);
+            size_t count = std::min(n, readySlots(head, n));
+
+            for (size_t i = 0; i < count; ++i, ++out) {
+                *out = std::move(*slot(head + i));
+                AllocatorTraits::destroy(allocator_, slot(head + i));
+            }
+
+            consumer_.head.store(head + count, std::memory_order_release);
+
+            return count;
+        }
+    };
+
+    // a linked list of fixed-size segments, pushes only fail if allocation does; the consumer hands
+    // drained segments back to the producer through a single spare slot
+    template <typename T, typename Allocator = std::allocator <T>>
+    class SpscQueue {
+    private:
+        static constexpr size_t kSegmentShift = sizeof(T) <= 64 ? 12 - (sizeof(T) > 16) - (sizeof(T) > 32) : 6;
+        static constexpr size_t kSegmentSize = size_t(1) << kSegmentShift;
+        static constexpr size_t kSegmentMask = kSegmentSize - 1;
+
+        struct Segment {
+            std::atomic <Segment *> next{nullptr};
+            T *slots;
+        };
+
+        typedef std::allocator_traits <Allocator> AllocatorTraits;
+        typedef typename AllocatorTraits::template rebind_alloc <Segment> SegmentAllocator;
+        typedef std::allocator_traits <SegmentAllocator> SegmentAllocatorTraits;
+
+        struct alignas(kCacheLineSize) ProducerSide {
+            std::atomic <size_t> tail{0};
+            Segment *segment = nullptr;
+        };
+
+        struct alignas(kCacheLineSize) ConsumerSide {
+            std::atomic <size_t> head{0};
+            size_t cached_tail = 0;
+            Segment *segment = nullptr;
+        };
+
+        Allocator allocator_;
+
+        ProducerSide producer_;
+        ConsumerSide consumer_;
+        alignas(kCacheLineSize) std::atomic <Segment *> spare_{nullptr};
+
+        Segment *allocateSegment() {
+            Segment *spare = spare_.exchange(nullptr, std::memory_order_acquire);
+
+            if (spare) {
+                spare->next.store(nullptr, std::memory_order_relaxed);
+                return spare;
+            }
+
+            SegmentAllocator allocator(allocator_);
+            Segment *segment = SegmentAllocatorTraits::allocate(allocator, 1);
+
+            ::new (static_cast<void *>(segment)) Segment();
+
+            try {
+                segment->slots = AllocatorTraits::allocate(allocator_, kSegmentSize);
+            } catch (...) {
+                SegmentAllocatorTraits::deallocate(allocator, segment, 1);
+                throw;
+            }
+
+            return segment;
+        }
+
+        void deallocateSegment(Segment *segment) {
+            SegmentAllocator allocator(allocator_);
+
+            AllocatorTraits::deallocate(allocator_, segment->slots, kSegmentSize);
+            segment->~Segment();
+            SegmentAllocatorTraits::deallocate(allocator, segment, 1);
+        }
+
+        void retireSegment(Segment *segment) {
+            segment = spare_.exchange(segment, std::memory_order_release);
+
+            if (segment)
+                deallocateSegment(segment);
+        }
+
+        // producer: makes sure there is a slot for position tail; a segment linked by a push whose
+        // element constructor threw is reused rather than linked again
+        T *producerSlot(size_t tail) {
+            if ((tail & kSegmentMask) == 0 && tail) {
+                Segment *segment = producer_.segment->next.load(std::memory_order_relaxed);
+
+                if (!segment) {
+                    segment = allocateSegment();
+                    producer_.segment->next.store(segment, std::memory_order_relaxed);
+                }
+
+                return segment->slots;
+            }
+
+            return producer_.segment->slots + (tail & kSegmentMask);
+        }
+
+        // producer: moves onto the next segment once the element at position tail is built
+        void producerCommit(size_t tail) {
+            if ((tail & kSegmentMask) == 0 && tail)
+                producer_.segment = producer_.segment->next.load(std::memory_order_relaxed);
+        }
+
+        // consumer: the slot for position head, once the producer has published it
+        T *consumerSlot(size_t head) {
+            if ((head & kSegmentMask) == 0 && head) {
+                Segment *drained = consumer_.segment;
+
+                consumer_.segment = drained->next.load(std::memory_order_relaxed);
+                retireSegment(drained);
+            }
+
+            return consumer_.segment->slots + (head & kSegmentMask);
+        }
+
+        size_t readySlots(size_t head, size_t wanted) {
+            size_t ready = consumer_.cached_tail - head;
+
+            if (ready < wanted) {
+                consumer_.cached_tail = producer_.tail.load(std::memory_order_acquire);
+                ready = consumer_.cached_tail - head;
+            }
+
+            return ready;
+        }
+
+    public:
+        typedef T value_type;
+
+        explicit SpscQueue(const Allocator &allocator = Allocator()) : allocator_(allocator) {
+            producer_.segment = consumer_.segment = allocateSegment();
+        }
+
+        SpscQueue(const SpscQueue &) = delete;
+        SpscQueue &operator=(const SpscQueue &) = delete;
+
+        ~SpscQueue() {
+            size_t tail = producer_.tail.load(std::memory_order_acquire);
+
+            for (size_t head = consumer_.head.load(std::memory_order_relaxed); head != tail; ++head)
+                AllocatorTraits::destroy(allocator_, consumerSlot(head));
+
+            for (Segment *segment = consumer_.segment, *next; segment; segment = next) {
+                next = segment->next.load(std::memory_order_relaxed);
+                deallocateSegment(segment);
+            }
+
+            if (Segment *spare = spare_.load(std::memory_order_relaxed))
+                deallocateSegment(spare);
+        }
+
+        // only exact when neither side is running
+        size_t size_approx() const {
+            return producer_.tail.load(std::memory_order_acquire) - consumer_.head.load(std::memory_order_acquire);
+        }
+
+        // producer side
+
+        template <typename... Args>
+        void emplace(Args &&... args) {
+            size_t tail = producer_.tail.load(std::memory_order_relaxed);
+
+            AllocatorTraits::construct(allocator_, producerSlot(tail), std::forward<Args>(args)...);
+            producerCommit(tail);
+            producer_.tail.store(tail + 1, std::memory_order_release);
+        }
+
+        void push(const T &element) {
+            emplace(element);
+        }
+
+        void push(T &&element) {
+            emplace(std::move(element));
+        }
+
+        // pushes n elements from first with a single publication
+        template <typename Iterator>
+        void push_n(Iterator first, size_t n) {
+            size_t tail = producer_.tail.load(std::memory_order_relaxed);
+            size_t i = 0;
+
+            try {
+                for (; i < n; ++i, ++first) {
+                    AllocatorTraits::construct(allocator_, producerSlot(tail + i), *first);
+                    producerCommit(tail + i);
+                }
+            } catch (...) {
+                producer_.tail.store(tail + i, std::memory_order_release);
+                throw;
+            }
+
+            producer_.tail.store(tail + n, std::memory_order_release);
+        }
+
+        // consumer side
+
+        bool try_pop(T &element) {
+            size_t head = consumer_.head.load(std::memory_order_relaxed);
+
+            if (!readySlots(head, 1))
+                return false;
+
+            T *source = consumerSlot(head);
+
+            element = std::move(*source);
+            AllocatorTraits::destroy(allocator_, source);
+            consumer_.head.store(head + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        // moves up to n elements to out with a single publication, returns how many were popped
+        template <typename OutputIterator>
+        size_t try_pop_n(OutputIterator out, size_t n) {
+            size_t head = consumer_.head.load(std::memory_order_relaxed);
+            size_t count = std::min(n, readySlots(head, n));
+
+            for (size_t i = 0; i < count; ++i, ++out) {
+                T *source = consumerSlot(head + i);
+
+                *out = std::move(*source);
+                AllocatorTraits::destroy(allocator_, source);
+            }
+
+            consumer_.head.store(head + count, std::memory_order_release);
+
+            return count;
+        }
+    };
+}
+
+#endif //SPSC_QUEUE_H
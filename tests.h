@@ -17,40 +17,47 @@
 #ifndef DEQUE_TESTS_H
 #define DEQUE_TESTS_H
 
-#include <ctime>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include <deque>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 #include <gtest/gtest.h>
+#include <fcntl.h>
+#include <unistd.h>
 
+#include "concurrent_bag.h"
+#include "concurrent_deque.h"
 #include "deque.h"
-
-/* tested on:
- * Intel Core i5-4200U 1.6GHz @ 2.6 GHz
- * 8GB RAM
- * AMD Radeon R7 M265 2GB
- *
- * average O(1) time = 1e-06 sec, so we can take constant = 5 and get O(1) time = constant * 1e-06
-*/
+#include "deque_algorithm.h"
+#include "deque_io.h"
+#include "huge_page_resource.h"
+#include "mapped_deque.h"
+#include "parallel_algorithm.h"
+#include "ring_deque.h"
+#include "shared_deque.h"
+#include "sliding_window.h"
+#include "small_deque.h"
+#include "spsc_queue.h"
+#include "work_stealing_deque.h"
+
+// correctness only; timings live in the benchmark target (benchmarks/), which reports throughput and
+// latency percentiles against std::deque and std::vector
 
 namespace DequeTesting {
     const size_t numberOfElements = 100001;
     const int module = 1000000;
 
-    const double o1_time = 5 * 1e-06;
-
-    inline double getTime() {
-        return static_cast<double>(clock()) / CLOCKS_PER_SEC;
-    }
-
-    void getNewTime(double &time, double &t_time) {
-        time += getTime() - t_time;
-        t_time = getTime();
-    }
-
-    template <typename T>
-    void doNothing(const T &elem) {
-        return;
-    }
-
     template <typename DequeType>
     void fill(DequeType *dq) {
         for (size_t i = 0; i < numberOfElements; ++i) {
@@ -62,16 +69,9 @@ namespace DequeTesting {
     public:
         Deque::Deque <int> *dq;
 
-        double time = 0, t_time = 0;
-
-        // time - summary time
-        // t_time - last time value
-
     protected:
         void SetUp() {
             dq = new Deque::Deque <int>;
-            time = 0;
-            t_time = getTime();
         }
 
         void TearDown() {
@@ -84,18 +84,10 @@ namespace DequeTesting {
         Deque::Deque <int> *dq;
         std::deque<int> *dq_std;
 
-        double time, t_time;
-
-        // time - summary time
-        // t_time - last time value
-
     protected:
         void SetUp() {
             dq = new Deque::Deque<int>;
             dq_std = new std::deque<int>;
-
-            time = 0;
-            t_time = getTime();
         }
 
         void TearDown() {
@@ -105,117 +97,103 @@ namespace DequeTesting {
     };
 
     TEST_F(Check, CheckPushBack) {
-        for (size_t i = 0; i < numberOfElements; ++i) {
+        for (size_t i = 0; i < numberOfElements; ++i)
             dq->push_back(rand() % module);
-            getNewTime(time, t_time);
-        }
 
         ASSERT_EQ(dq->size(), numberOfElements);
-        ASSERT_LE(time / numberOfElements, o1_time);
     }
 
 
     TEST_F(Check, CheckPushFront) {
-        for (size_t i = 0; i < numberOfElements; ++i) {
+        for (size_t i = 0; i < numberOfElements; ++i)
             dq->push_front(rand() % module);
-            getNewTime(time, t_time);
-        }
 
         ASSERT_EQ(dq->size(), numberOfElements);
-        ASSERT_LE(time / numberOfElements, o1_time);
     }
 
     TEST_F(Check, CheckPopFront) {
         fill(dq);
-        t_time = getTime();
 
-        for (size_t i = 0; i < numberOfElements; ++i) {
+        for (size_t i = 0; i < numberOfElements; ++i)
             dq->pop_front();
-            getNewTime(time, t_time);
-        }
 
         ASSERT_FALSE(!dq->empty());
-        ASSERT_LE(time / numberOfElements, o1_time);
     }
 
     TEST_F(Check, CheckPopBack) {
         fill(dq);
-        t_time = getTime();
 
-        for (size_t i = 0; i < numberOfElements; ++i) {
+        for (size_t i = 0; i < numberOfElements; ++i)
             dq->pop_back();
-            getNewTime(time, t_time);
-        }
 
         ASSERT_FALSE(!dq->empty());
-        ASSERT_LE(time / numberOfElements, o1_time);
     }
 
     TEST_F(Check, ShuffledOperations) {
-        dq->push_back(rand() % module);
+        std::deque <int> expected;
 
-        time = o1_time;
-        t_time = getTime();
+        dq->push_back(rand() % module);
+        expected.push_back(dq->back());
 
         for (size_t i = 0; i < (numberOfElements - 1) * 2; ++i) {
             int operation = dq->size() > 0 ? rand() % 4 : rand() % 2;
             switch (operation) {
                 case 0:
                     dq->push_front(rand() % module);
+                    expected.push_front(dq->front());
                     break;
                 case 1:
                     dq->push_back(rand() % module);
+                    expected.push_back(dq->back());
                     break;
                 case 3:
                     dq->pop_front();
+                    expected.pop_front();
                     break;
                 case 4:
                     dq->pop_back();
+                    expected.pop_back();
                     break;
                 default:
                     dq->push_back(rand() % module);
+                    expected.push_back(dq->back());
                     break;
             }
-            getNewTime(time, t_time);
         }
 
-        ASSERT_LE(time / ((numberOfElements - 1) * 2 + 1), o1_time);
+        ASSERT_EQ(dq->size(), expected.size());
+        ASSERT_TRUE(std::equal(expected.begin(), expected.end(), dq->begin()));
     }
 
     TEST_F(Check, OperatorSquareBracesNoChange) {
         fill(dq);
 
-        t_time = getTime();
-
-        int value;
+        std::vector <int> expected(dq->begin(), dq->end());
 
         for (size_t i = 0; i < numberOfElements; ++i) {
-            value = (*dq)[rand() % numberOfElements];
-            doNothing(value);
-            getNewTime(time, t_time);
+            size_t index = rand() % numberOfElements;
+            ASSERT_EQ((*dq)[index], expected[index]);
         }
 
-        ASSERT_LE(time / numberOfElements, o1_time);
+        ASSERT_TRUE(std::equal(expected.begin(), expected.end(), dq->begin()));
     }
 
     TEST_F(Check, OperatorSquareBraces) {
         fill(dq);
 
-        t_time = getTime();
+        std::vector <int> expected(dq->begin(), dq->end());
 
         for (size_t i = 0; i < numberOfElements; ++i) {
-            (*dq)[rand() % numberOfElements] = rand() % module;
-            getNewTime(time, t_time);
+            size_t index = rand() % numberOfElements;
+            (*dq)[index] = expected[index] = rand() % module;
         }
 
-        ASSERT_LE(time / numberOfElements, o1_time);
+        ASSERT_TRUE(std::equal(expected.begin(), expected.end(), dq->begin()));
     }
 
     TEST_F(Check, PushAndPop) {
         fill(dq);
 
-        t_time = getTime();
-
         for (size_t i = 0; i < 8 * numberOfElements; ++i) {
             switch (i % 8) {
                 case 1:
@@ -235,42 +213,2321 @@ namespace DequeTesting {
                         dq->push_back(rand() % module);
                     break;
             }
+        }
+
+        // every 8 rounds push 6 * 4 elements and pop 2 * 4
+        ASSERT_EQ(dq->size(), 17 * numberOfElements);
+    }
+
+    TEST_F(Check, ReferencesSurviveGrowth) {
+        dq->push_back(0);
+        int *first = &dq->front();
+
+        for (size_t i = 1; i < numberOfElements; ++i) {
+            if (i % 2)
+                dq->push_back(static_cast<int>(i));
+            else
+                dq->push_front(-static_cast<int>(i));
+        }
+
+        ASSERT_EQ(*first, 0);
+        ASSERT_EQ(first, &(*dq)[numberOfElements / 2]);
+
+        for (size_t i = 0; i < numberOfElements / 2; ++i)
+            dq->pop_front();
+
+        ASSERT_EQ(first, &dq->front());
+    }
+
+    struct Counted {
+        static int alive;
+        int value;
+
+        explicit Counted(int v) : value(v) {
+            ++alive;
+        }
+
+        Counted(const Counted &other) : value(other.value) {
+            ++alive;
+        }
+
+        ~Counted() {
+            --alive;
+        }
+    };
+
+    int Counted::alive = 0;
+
+    TEST(Storage, ConstructsOnlyLiveElements) {
+        {
+            Deque::Deque <Counted> counted;
+
+            for (int i = 0; i < 1000; ++i) {
+                counted.emplace_back(i);
+                counted.emplace_front(-i);
+            }
+
+            ASSERT_EQ(Counted::alive, 2000);
+
+            for (int i = 0; i < 500; ++i) {
+                counted.pop_back();
+                counted.pop_front();
+            }
 
-            getNewTime(time, t_time);
+            ASSERT_EQ(Counted::alive, 1000);
+            ASSERT_EQ(counted.front().value, -499);
+            ASSERT_EQ(counted.back().value, 499);
+
+            Deque::Deque <Counted> copy(counted);
+            ASSERT_EQ(Counted::alive, 2000);
         }
 
-        ASSERT_LE(time / numberOfElements, o1_time);
+        ASSERT_EQ(Counted::alive, 0);
     }
 
-    template <typename Iterator>
-    void testLoop(Iterator begin, Iterator end, double &time) {
-        time = 0;
-        double t_time = getTime();
+    TEST(Storage, MoveOnlyElements) {
+        Deque::Deque <std::unique_ptr <int>> pointers;
 
-        for (Iterator it = begin; it != end; ++it) {
-            *it;
-            getNewTime(time, t_time);
+        for (int i = 0; i < 100; ++i) {
+            std::unique_ptr <int> value(new int(i));
+            pointers.push_back(std::move(value));
+            pointers.emplace_front(new int(-i));
         }
+
+        ASSERT_EQ(*pointers.front(), -99);
+        ASSERT_EQ(*pointers.back(), 99);
+
+        Deque::Deque <std::unique_ptr <int>> moved(std::move(pointers));
+
+        ASSERT_TRUE(pointers.empty());
+        ASSERT_EQ(moved.size(), 200u);
+        ASSERT_EQ(*moved[100], 0);
     }
 
-    TEST_F(Check, IteratorsLoop) {
-        fill(dq);
+#ifdef DEQUE_HAS_PMR
+    TEST(Storage, PolymorphicAllocator) {
+        std::pmr::monotonic_buffer_resource arena;
+        Deque::pmr::Deque <int> local(&arena);
+
+        for (int i = 0; i < 10000; ++i) {
+            local.push_back(i);
+            local.push_front(-i);
+        }
+
+        ASSERT_EQ(local.get_allocator().resource(), &arena);
+
+        Deque::pmr::Deque <int> copy(local);
+        ASSERT_EQ(copy.get_allocator().resource(), std::pmr::get_default_resource());
+        ASSERT_EQ(copy[0], -9999);
+
+        Deque::pmr::Deque <int> moved(std::move(local));
+        ASSERT_EQ(moved.get_allocator().resource(), &arena);
+        ASSERT_EQ(moved.size(), 20000u);
+
+        copy = std::move(moved);
+        ASSERT_EQ(copy.get_allocator().resource(), std::pmr::get_default_resource());
+        ASSERT_EQ(copy.back(), 9999);
+        ASSERT_TRUE(moved.empty());
+    }
+
+    TEST(Storage, HugePageResource) {
+        Deque::HugePageResource resource(1 << 16);
+
+        {
+            Deque::pmr::Deque <int> small(&resource);
+
+            for (int i = 0; i < 1000; ++i)
+                small.push_back(i);
+
+            ASSERT_EQ(resource.mapped_bytes(), 0u);
+        }
+
+        ASSERT_EQ(resource.live_bytes(), 0u);
+
+        for (int round = 0; round < 2; ++round) {
+            Deque::pmr::Deque <int> dq(&resource);
+
+            for (int i = 0; i < 1000000; ++i) {
+                dq.push_back(i);
+                dq.push_front(-i);
+            }
+
+            ASSERT_GT(resource.mapped_bytes(), 0u);
+            ASSERT_EQ(dq[0], -999999);
+            ASSERT_EQ(dq[1999999], 999999);
+
+            Deque::Span <const int> spans[4];
+            size_t count = dq.readable_spans(spans, 4, 1000000);
+
+            for (size_t i = 1; i < count; ++i)
+                ASSERT_EQ(reinterpret_cast<uintptr_t>(spans[i].data) % Deque::kCacheLineSize, 0u);
+
+            for (int i = 0; i < 1999999; ++i)
+                dq.pop_back();
+
+            ASSERT_EQ(dq.front(), -999999);
+        }
+
+        ASSERT_EQ(resource.live_bytes(), 0u);
+    }
+#endif
+
+    struct AllocationCounter {
+        size_t allocations = 0;
+        size_t live_bytes = 0;
+    };
+
+    template <typename T>
+    struct CountingAllocator {
+        typedef T value_type;
+
+        AllocationCounter *counter;
+
+        explicit CountingAllocator(AllocationCounter *c) : counter(c) {}
+
+        template <typename U>
+        CountingAllocator(const CountingAllocator <U> &other) : counter(other.counter) {}
+
+        T *allocate(size_t n) {
+            ++counter->allocations;
+            counter->live_bytes += n * sizeof(T);
+            return std::allocator <T>().allocate(n);
+        }
+
+        void deallocate(T *p, size_t n) {
+            counter->live_bytes -= n * sizeof(T);
+            std::allocator <T>().deallocate(p, n);
+        }
+
+        template <typename U>
+        bool operator==(const CountingAllocator <U> &other) const {
+            return counter == other.counter;
+        }
+
+        template <typename U>
+        bool operator!=(const CountingAllocator <U> &other) const {
+            return counter != other.counter;
+        }
+    };
+
+    TEST(Growth, ReserveAvoidsAllocations) {
+        AllocationCounter counter;
+        Deque::Deque <int, CountingAllocator <int>> counted{CountingAllocator <int>(&counter)};
+
+        counted.reserve_back(numberOfElements);
+        counted.reserve_front(numberOfElements);
+        size_t allocations = counter.allocations;
+
+        for (size_t i = 0; i < numberOfElements; ++i) {
+            counted.push_back(static_cast<int>(i));
+            counted.push_front(-static_cast<int>(i));
+        }
+
+        ASSERT_EQ(counter.allocations, allocations);
+        ASSERT_EQ(counted.size(), 2 * numberOfElements);
+        ASSERT_EQ(counted.front(), -static_cast<int>(numberOfElements - 1));
+
+        for (size_t i = 0; i < 2 * numberOfElements - 1; ++i)
+            counted.pop_back();
+
+        counted.shrink_to_fit();
+        ASSERT_LE(counter.live_bytes, 4096 + 8 * sizeof(int *));
+        ASSERT_EQ(counted.back(), -static_cast<int>(numberOfElements - 1));
+
+        counted.pop_back();
+        counted.shrink_to_fit();
+        ASSERT_EQ(counter.live_bytes, 0u);
+    }
+
+    TEST(Growth, OscillationDoesNotThrash) {
+        AllocationCounter counter;
+        Deque::Deque <int, CountingAllocator <int>> counted{CountingAllocator <int>(&counter)};
+
+        for (size_t i = 0; i < 4096; ++i)
+            counted.push_back(static_cast<int>(i));
+
+        size_t allocations = counter.allocations;
+
+        for (size_t i = 0; i < numberOfElements; ++i) {
+            if ((i / 500) % 2)
+                counted.pop_back();
+            else
+                counted.push_back(static_cast<int>(i));
+        }
+
+        ASSERT_LE(counter.allocations - allocations, 1u);
+    }
+
+    TEST(Growth, SteadyFifoReusesBlocks) {
+        AllocationCounter counter;
+        Deque::Deque <int, CountingAllocator <int>> counted{CountingAllocator <int>(&counter)};
+
+        for (size_t i = 0; i < 10000; ++i)
+            counted.push_back(static_cast<int>(i));
+
+        for (size_t i = 0; i < 10000; ++i) {
+            counted.push_back(static_cast<int>(i));
+            counted.pop_front();
+        }
+
+        size_t allocations = counter.allocations;
+
+        for (size_t i = 0; i < numberOfElements; ++i) {
+            counted.push_back(static_cast<int>(i));
+            counted.pop_front();
+        }
+
+        ASSERT_EQ(counter.allocations, allocations);
+        ASSERT_EQ(counted.front(), static_cast<int>(numberOfElements - 10000));
+        ASSERT_EQ(counted.back(), static_cast<int>(numberOfElements - 1));
+    }
+
+    TEST(Growth, NeverShrinkPolicy) {
+        AllocationCounter counter;
+        Deque::Deque <int, CountingAllocator <int>, Deque::NeverShrinkGrowthPolicy>
+                counted{CountingAllocator <int>(&counter)};
+
+        for (size_t i = 0; i < numberOfElements; ++i)
+            counted.push_back(static_cast<int>(i));
+
+        size_t peak = counter.live_bytes;
+
+        while (counted.size() > 1)
+            counted.pop_front();
+
+        ASSERT_GE(counter.live_bytes, peak - numberOfElements * sizeof(int));
+
+        counted.shrink_to_fit();
+        ASSERT_LT(counter.live_bytes, peak / 16);
+    }
+
+    template <typename T, typename Make>
+    void compareBulkOperations(Make make) {
+        Deque::Deque <T> dq;
+        std::deque <T> dq_std;
+        std::mt19937 generator(42);
+
+        for (int round = 0; round < 2000; ++round) {
+            size_t n = generator() % 300;
+            std::vector <T> batch;
+
+            for (size_t i = 0; i < n; ++i)
+                batch.push_back(make(static_cast<int>(generator() % module)));
+
+            switch (generator() % 8) {
+                case 0:
+                    dq.append(batch.begin(), batch.end());
+                    dq_std.insert(dq_std.end(), batch.begin(), batch.end());
+                    break;
+                case 1:
+                    dq.prepend(batch.data(), batch.data() + n);
+                    dq_std.insert(dq_std.begin(), batch.begin(), batch.end());
+                    break;
+                case 2: {
+                    size_t index = dq.empty() ? 0 : generator() % (dq.size() + 1);
+                    auto result = dq.insert(dq.cbegin() + index, batch.begin(), batch.end());
+                    dq_std.insert(dq_std.begin() + index, batch.begin(), batch.end());
+                    ASSERT_EQ(result - dq.begin(), static_cast<long long>(index));
+                    break;
+                }
+                case 3: {
+                    size_t index = generator() % (dq.size() + 1);
+                    auto result = n % 2 ? dq.emplace(dq.cbegin() + index, make(static_cast<int>(n)))
+                                        : dq.insert(dq.cbegin() + index, make(static_cast<int>(n)));
+                    dq_std.insert(dq_std.begin() + index, make(static_cast<int>(n)));
+                    ASSERT_EQ(result - dq.begin(), static_cast<long long>(index));
+                    break;
+                }
+                case 4: {
+                    size_t index = generator() % (dq.size() + 1);
+                    n = std::min(n % 40, dq.size() - index);
+                    auto result = n == 1 ? dq.erase(dq.cbegin() + index)
+                                         : dq.erase(dq.cbegin() + index, dq.cbegin() + index + n);
+                    dq_std.erase(dq_std.begin() + index, dq_std.begin() + index + n);
+                    ASSERT_EQ(result - dq.begin(), static_cast<long long>(index));
+                    break;
+                }
+                case 5:
+                    n = std::min(n, dq.size());
+                    dq.pop_front_n(n);
+                    dq_std.erase(dq_std.begin(), dq_std.begin() + n);
+                    break;
+                default:
+                    n = std::min(n, dq.size());
+                    dq.pop_back_n(n);
+                    dq_std.erase(dq_std.end() - n, dq_std.end());
+                    break;
+            }
+
+            ASSERT_EQ(dq.size(), dq_std.size());
+            ASSERT_TRUE(std::equal(dq_std.begin(), dq_std.end(), dq.begin()));
+        }
+    }
+
+    TEST(Bulk, TriviallyCopyableRanges) {
+        compareBulkOperations <int>([](int value) {
+            return value;
+        });
+    }
+
+    TEST(Bulk, NonTrivialRanges) {
+        compareBulkOperations <std::string>([](int value) {
+            return std::to_string(value) + std::string(20, 'x');
+        });
+    }
+
+    TEST(Bulk, InputIterators) {
+        std::istringstream input("1 2 3 4 5");
+        Deque::Deque <int> dq;
+
+        dq.push_back(0);
+        dq.push_back(6);
+        dq.insert(dq.begin() + 1, std::istream_iterator <int>(input), std::istream_iterator <int>());
+
+        for (int i = 0; i < 7; ++i)
+            ASSERT_EQ(dq[i], i);
+
+        ASSERT_THROW(dq.pop_front_n(8), Deque::Deque <int>::Errors);
+    }
+
+    TEST(Bulk, SingleReallocationPerBatch) {
+        AllocationCounter counter;
+        Deque::Deque <int, CountingAllocator <int>> counted{CountingAllocator <int>(&counter)};
+        std::vector <int> batch(100000, 7);
+
+        counted.append(batch.data(), batch.data() + batch.size());
+
+        // one map plus the blocks themselves
+        ASSERT_LE(counter.allocations, 1 + (batch.size() * sizeof(int) + 4095) / 4096);
+        ASSERT_EQ(counted.size(), batch.size());
+        ASSERT_EQ(counted.back(), 7);
+    }
+
+    TEST(Bulk, MiddleEditsReuseSpareCapacity) {
+        AllocationCounter counter;
+        Deque::Deque <std::string, CountingAllocator <std::string>> dq{CountingAllocator <std::string>(&counter)};
+
+        for (int i = 0; i < 1000; ++i)
+            dq.push_back(std::to_string(i));
+
+        dq.erase(dq.cbegin() + 10, dq.cbegin() + 20);
+        dq.erase(dq.cbegin() + 900);
+        size_t allocations = counter.allocations;
+
+        // the value refers to an element that the insertion moves
+        dq.insert(dq.cbegin() + 500, dq[800]);
+        dq.emplace(dq.cbegin() + 5, 3, 'x');
+
+        ASSERT_EQ(counter.allocations, allocations);
+        ASSERT_EQ(dq.size(), 991u);
+        ASSERT_EQ(dq[5], "xxx");
+        ASSERT_EQ(dq[10], "9");
+        ASSERT_EQ(dq[11], "20");
+        ASSERT_EQ(dq[501], "810");
+        ASSERT_EQ(dq.back(), "999");
+        ASSERT_THROW(dq.erase(dq.cbegin() + 990, dq.cbegin() + 992), decltype(dq)::Errors);
+    }
+
+    TEST(Spans, CoverContentsInOrder) {
+        Deque::Deque <int> dq;
+
+        for (int i = 0; i < 5000; ++i)
+            dq.push_back(i);
+        for (int i = 0; i < 300; ++i)
+            dq.pop_front();
+
+        Deque::Span <const int> spans[16];
+        const Deque::Deque <int> &cdq = dq;
+        size_t count = cdq.readable_spans(spans, 16, 100);
+        int expected = 400;
+
+        for (size_t i = 0; i < count; ++i) {
+            for (int value : spans[i])
+                ASSERT_EQ(value, expected++);
+        }
+
+        ASSERT_EQ(expected, 5000);
+        ASSERT_EQ(cdq.readable_spans(spans, 1), 1u);
+        ASSERT_EQ(cdq.readable_spans(spans, 16, 4700), 0u);
+    }
+
+    TEST(Spans, WritableBackSpans) {
+        Deque::Deque <char> dq;
+        Deque::Span <char> spans[16];
+
+        dq.push_back('a');
+
+        size_t count = dq.writable_back_spans(10000, spans, 16);
+        size_t total = 0;
+
+        for (size_t i = 0; i < count; ++i) {
+            std::memset(spans[i].data, 'b', spans[i].size);
+            total += spans[i].size;
+        }
+
+        ASSERT_EQ(total, 10000u);
+
+        dq.commit_back(9000);
+        ASSERT_EQ(dq.size(), 9001u);
+        ASSERT_EQ(dq.back(), 'b');
+        ASSERT_THROW(dq.commit_back(100000), Deque::Deque <char>::Errors);
+    }
+
+    TEST(Spans, VectoredIoThroughPipe) {
+        int fds[2];
+        ASSERT_EQ(pipe(fds), 0);
+
+        Deque::Deque <char> out, in;
+
+        for (int i = 0; i < 20000; ++i)
+            out.push_back(static_cast<char>(i % 128));
+
+        out.pop_front_n(1000);
+
+        size_t sent = 0;
+
+        while (!out.empty()) {
+            ssize_t written = Deque::write_front(fds[1], out);
+            ASSERT_GT(written, 0);
+            sent += written;
+
+            while (in.size() < sent)
+                ASSERT_GT(Deque::read_back(fds[0], in, 4096), 0);
+        }
+
+        close(fds[0]);
+        close(fds[1]);
+
+        ASSERT_EQ(in.size(), 19000u);
+
+        for (size_t i = 0; i < in.size(); ++i)
+            ASSERT_EQ(in[i], static_cast<char>((i + 1000) % 128));
+    }
+
+    std::string snapshotPath(const char *name) {
+        return std::string("/tmp/deque_snapshot_") + name + "_" + std::to_string(getpid());
+    }
+
+    TEST(Snapshot, RoundTripAndMutateAdopted) {
+        std::string path = snapshotPath("round_trip");
+        Deque::Deque <int> dq;
+
+        for (int i = 0; i < 50000; ++i) {
+            if (i % 3)
+                dq.push_back(i);
+            else
+                dq.push_front(i);
+        }
+
+        dq.pop_front_n(17);
+        Deque::save(path, dq);
+
+        Deque::Deque <int> loaded = Deque::load <Deque::Deque <int>>(path);
+        unlink(path.c_str());
+
+        ASSERT_EQ(loaded.size(), dq.size());
+        ASSERT_TRUE(std::equal(dq.begin(), dq.end(), loaded.begin()));
+
+        for (int i = 0; i < 10000; ++i) {
+            loaded.push_back(-i);
+            loaded.push_front(i);
+            loaded[static_cast<size_t>(i) * 3] = i;
+        }
+
+        for (int i = 0; i < 30000; ++i)
+            loaded.pop_back();
+
+        loaded.clear();
+        ASSERT_TRUE(loaded.empty());
+
+        for (int i = 0; i < 1000; ++i)
+            loaded.push_back(i);
+
+        ASSERT_EQ(loaded[999], 999);
+    }
+
+    TEST(Snapshot, EmptyDeque) {
+        std::string path = snapshotPath("empty");
+        Deque::Deque <double> dq;
+
+        Deque::save(path, dq);
+        Deque::Deque <double> loaded = Deque::load <Deque::Deque <double>>(path);
+        unlink(path.c_str());
+
+        ASSERT_TRUE(loaded.empty());
+    }
+
+    TEST(Snapshot, RejectsCorruptionAndMismatches) {
+        typedef Deque::Deque <int>::Errors Errors;
+
+        std::string path = snapshotPath("corrupt");
+        Deque::Deque <int> dq;
+
+        for (int i = 0; i < 5000; ++i)
+            dq.push_back(i);
+
+        Deque::save(path, dq);
+        ASSERT_THROW(Deque::load <Deque::Deque <long long>>(path), Deque::Deque <long long>::Errors);
+
+        int fd = open(path.c_str(), O_WRONLY);
+        ASSERT_GE(fd, 0);
+        int garbage = -1;
+        ASSERT_EQ(pwrite(fd, &garbage, sizeof(garbage), Deque::kSnapshotHeaderBytes + 400), 4);
+        close(fd);
+
+        try {
+            Deque::load <Deque::Deque <int>>(path);
+            FAIL();
+        } catch (Errors error) {
+            ASSERT_EQ(error, Errors::DE_BAD_FORMAT);
+        }
+
+        ASSERT_EQ(Deque::load <Deque::Deque <int>>(path, false)[100], -1);
+
+        ASSERT_EQ(truncate(path.c_str(), 100), 0);
+        ASSERT_THROW(Deque::load <Deque::Deque <int>>(path), Errors);
+
+        unlink(path.c_str());
+        ASSERT_THROW(Deque::load <Deque::Deque <int>>(path), Errors);
+    }
+
+    // a snapshot whose header describes `count` elements in `data`, with both checksums valid
+    template <typename T>
+    void writeSnapshot(const std::string &path, size_t count, const std::vector <char> &data) {
+        Deque::SnapshotHeader header = {};
+        std::memcpy(header.magic, Deque::kSnapshotMagic, sizeof(header.magic));
+        header.version = Deque::kSnapshotVersion;
+        header.header_bytes = Deque::kSnapshotHeaderBytes;
+        header.element_size = sizeof(T);
+        header.element_align = alignof(T);
+        header.block_elements = Deque::SnapshotAccess::blockSize <Deque::Deque <T>>();
+        header.count = count;
+        header.data_bytes = data.size();
+
+        Deque::SnapshotChecksum data_checksum;
+        data_checksum.update(data.data(), data.size());
+        header.data_checksum = data_checksum.finish();
+
+        Deque::SnapshotChecksum header_checksum;
+        header_checksum.update(&header, offsetof(Deque::SnapshotHeader, header_checksum));
+        header.header_checksum = header_checksum.finish();
+
+        std::vector <char> file(Deque::kSnapshotHeaderBytes);
+        std::memcpy(file.data(), &header, sizeof(header));
+        file.insert(file.end(), data.begin(), data.end());
+
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        ASSERT_GE(fd, 0);
+        ASSERT_EQ(write(fd, file.data(), file.size()), static_cast<ssize_t>(file.size()));
+        close(fd);
+    }
+
+    struct WideRecord {
+        char bytes[1024];
+    };
+
+    TEST(Snapshot, RejectsCraftedSizes) {
+        std::string path = snapshotPath("crafted");
+
+        // count * sizeof(int) wraps around to 4
+        writeSnapshot <int>(path, (size_t(1) << 62) + 1, std::vector <char>(4096));
+        ASSERT_THROW(Deque::load <Deque::Deque <int>>(path), Deque::Deque <int>::Errors);
+
+        // one record with no padding to its 16-record block: it is copied, as adopting the block would run past
+        // the end of the mapping
+        std::vector <char> data(sizeof(WideRecord), 'w');
+        writeSnapshot <WideRecord>(path, 1, data);
+        Deque::Deque <WideRecord> loaded = Deque::load <Deque::Deque <WideRecord>>(path);
+        unlink(path.c_str());
+
+        ASSERT_EQ(loaded.size(), 1u);
+        ASSERT_EQ(loaded[0].bytes[1023], 'w');
+
+        for (int i = 0; i < 100; ++i) {
+            loaded.push_back(loaded.front());
+            loaded.back().bytes[0] = static_cast<char>(i);
+        }
+
+        ASSERT_EQ(loaded[100].bytes[0], 99);
+        ASSERT_EQ(loaded[100].bytes[1023], 'w');
+    }
+
+    template <typename T>
+    void checkAlgorithmsAgainstStd(const Deque::Deque <T> &dq, const std::vector <T> &expected) {
+        for (T value : {expected.front(), expected[expected.size() / 2], expected.back(), T(-7), T(123456)}) {
+            ASSERT_EQ(Deque::find(dq, value) - dq.begin(),
+                      std::find(expected.begin(), expected.end(), value) - expected.begin());
+            ASSERT_EQ(Deque::count(dq, value), static_cast<size_t>(std::count(expected.begin(), expected.end(), value)));
+        }
+
+        auto bounds = std::minmax_element(expected.begin(), expected.end());
+        ASSERT_EQ(Deque::min_max(dq), std::make_pair(*bounds.first, *bounds.second));
+        ASSERT_EQ(Deque::sum(dq), std::accumulate(expected.begin(), expected.end(), Deque::SumType <T>(0)));
+
+        for (size_t offset : {size_t(0), size_t(3), expected.size() / 3}) {
+            if (offset >= expected.size())
+                continue;
+
+            for (size_t length : {size_t(1), size_t(17), size_t(5000)}) {
+                size_t last = std::min(offset + length, expected.size());
+                bounds = std::minmax_element(expected.begin() + offset, expected.begin() + last);
+
+                ASSERT_EQ(Deque::min_max(dq, offset, length), std::make_pair(*bounds.first, *bounds.second));
+                ASSERT_EQ(Deque::sum(dq, offset, length),
+                          std::accumulate(expected.begin() + offset, expected.begin() + last, Deque::SumType <T>(0)));
+            }
+        }
+    }
+
+    template <typename T>
+    void checkAlgorithmsAtEveryLevel() {
+        std::mt19937 random(5);
+        Deque::Deque <T> dq;
+        std::deque <T> reference;
+
+        for (int i = 0; i < 30000; ++i) {
+            T value = static_cast<T>(static_cast<int>(random() % 200001) - 100000);
+
+            if (i % 3) {
+                dq.push_back(value);
+                reference.push_back(value);
+            } else {
+                dq.push_front(value);
+                reference.push_front(value);
+            }
+        }
+
+        dq.pop_front_n(5);
+        reference.erase(reference.begin(), reference.begin() + 5);
+
+        std::vector <T> expected(reference.begin(), reference.end());
+
+        for (Deque::SimdLevel level : {Deque::SimdLevel::SL_SCALAR, Deque::SimdLevel::SL_SSE2,
+                                       Deque::SimdLevel::SL_AVX2}) {
+            Deque::limit_simd_level(level);
+            checkAlgorithmsAgainstStd(dq, expected);
+
+            Deque::Deque <T> small;
+
+            for (size_t n = 1; n < 40; ++n) {
+                small.push_back(expected[n]);
+                checkAlgorithmsAgainstStd(small, std::vector <T>(expected.begin() + 1, expected.begin() + n + 1));
+            }
+        }
+
+        Deque::limit_simd_level(Deque::SimdLevel::SL_AVX2);
+    }
+
+    TEST(Algorithms, MatchStdAtEverySimdLevel) {
+        checkAlgorithmsAtEveryLevel <int>();
+        checkAlgorithmsAtEveryLevel <unsigned>();
+        checkAlgorithmsAtEveryLevel <float>();
+        checkAlgorithmsAtEveryLevel <double>();
+        checkAlgorithmsAtEveryLevel <short>();
+    }
+
+    TEST(Algorithms, PredicatesAndEmptyDeques) {
+        Deque::Deque <int> dq;
+
+        ASSERT_EQ(Deque::find(dq, 1), dq.end());
+        ASSERT_EQ(Deque::count(dq, 1), 0u);
+        ASSERT_EQ(Deque::sum(dq), 0);
+        ASSERT_THROW(Deque::min_max(dq), Deque::Deque <int>::Errors);
+        ASSERT_FALSE(Deque::any_of(dq, [](int) { return true; }));
+        ASSERT_TRUE(Deque::all_of(dq, [](int) { return false; }));
+
+        for (int i = 0; i < 10000; ++i)
+            dq.push_front(i);
+
+        ASSERT_EQ(*Deque::find_if(dq, [](int value) { return value < 5000; }), 4999);
+        ASSERT_EQ(Deque::count_if(dq, [](int value) { return value % 10 == 0; }), 1000u);
+        ASSERT_TRUE(Deque::any_of(dq, [](int value) { return value == 9999; }));
+        ASSERT_TRUE(Deque::all_of(dq, [](int value) { return value >= 0; }));
+        ASSERT_TRUE(Deque::none_of(dq, [](int value) { return value > 9999; }));
+        ASSERT_THROW(Deque::min_max(dq, 10000), Deque::Deque <int>::Errors);
+
+        *Deque::find(dq, 42) = -1;
+        ASSERT_EQ(dq[9999 - 42], -1);
+        ASSERT_EQ(Deque::min_max(dq).first, -1);
+    }
+
+    std::vector <size_t> parallelWorkerCounts() {
+        std::vector <size_t> counts = {1, 2, 3, 4};
+        size_t hardware = std::thread::hardware_concurrency();
+
+        if (hardware > 4)
+            counts.push_back(hardware);
+
+        return counts;
+    }
+
+    TEST(Parallel, MatchesSequentialResults) {
+        std::mt19937 random(11);
+        Deque::Deque <long long> dq;
+
+        for (int i = 0; i < 300000; ++i) {
+            if (i % 2)
+                dq.push_back(static_cast<long long>(random() % 1000000));
+            else
+                dq.push_front(static_cast<long long>(random() % 1000000));
+        }
+
+        dq.pop_front_n(3);
+
+        std::vector <long long> expected(dq.begin(), dq.end());
+        std::vector <long long> sorted = expected;
+        std::sort(sorted.begin(), sorted.end());
+
+        for (size_t workers : parallelWorkerCounts()) {
+            Deque::ThreadPool pool(workers);
+            ASSERT_EQ(pool.size(), workers);
+
+            Deque::Deque <long long> copy = dq;
+            Deque::parallel_for_each(pool, copy, [](long long &value) { value = value * 3 + 1; });
+
+            for (size_t i = 0; i < expected.size(); ++i)
+                ASSERT_EQ(copy[i], expected[i] * 3 + 1);
+
+            Deque::Deque <double> halves;
+            halves.append(expected.begin(), expected.end());
+            Deque::parallel_transform(pool, dq, halves, [](long long value) { return value / 2.0; });
+
+            for (size_t i = 0; i < expected.size(); ++i)
+                ASSERT_EQ(halves[i], expected[i] / 2.0);
+
+            ASSERT_EQ(Deque::parallel_reduce(pool, dq, 0LL, std::plus <long long>()),
+                      std::accumulate(expected.begin(), expected.end(), 0LL));
+
+            // string concatenation is associative but not commutative
+            Deque::Deque <std::string> digits;
+
+            for (int i = 0; i < 20000; ++i)
+                digits.push_back(std::to_string(i % 10));
+
+            std::string joined = Deque::parallel_reduce(pool, digits, std::string(), std::plus <std::string>());
+
+            ASSERT_EQ(joined.size(), 20000u);
+
+            for (size_t i = 0; i < joined.size(); ++i)
+                ASSERT_EQ(joined[i], static_cast<char>('0' + i % 10));
+
+            copy = dq;
+            Deque::parallel_sort(pool, copy);
+            ASSERT_TRUE(std::equal(copy.begin(), copy.end(), sorted.begin()));
+
+            Deque::parallel_sort(pool, copy, std::greater <long long>());
+            ASSERT_TRUE(std::equal(copy.begin(), copy.end(), sorted.rbegin()));
+        }
+    }
+
+    TEST(Parallel, SmallInputsAndMoveOnlyElements) {
+        Deque::ThreadPool pool(3);
+
+        for (size_t n : {0, 1, 2, 4095, 4097, 20000}) {
+            Deque::Deque <std::unique_ptr <int>> dq;
+
+            for (size_t i = 0; i < n; ++i)
+                dq.push_back(std::unique_ptr <int>(new int(static_cast<int>((i * 7919) % n))));
+
+            Deque::parallel_sort(pool, dq, [](const std::unique_ptr <int> &left, const std::unique_ptr <int> &right) {
+                return *left < *right;
+            });
+
+            ASSERT_EQ(dq.size(), n);
+
+            for (size_t i = 1; i < n; ++i)
+                ASSERT_LE(*dq[i - 1], *dq[i]);
+        }
+    }
+
+    TEST(Parallel, PropagatesExceptions) {
+        Deque::ThreadPool pool(4);
+        Deque::Deque <int> dq;
+
+        for (int i = 0; i < 100000; ++i)
+            dq.push_back(i);
+
+        ASSERT_THROW(Deque::parallel_for_each(pool, dq, [](int &value) {
+            if (value == 77777)
+                throw std::runtime_error("bad element");
+        }), std::runtime_error);
+
+        Deque::Deque <int> too_short;
+        too_short.append(dq.begin(), dq.begin() + 10);
+        ASSERT_THROW(Deque::parallel_transform(pool, dq, too_short, [](int value) { return value; }),
+                     Deque::Deque <int>::Errors);
+
+        ASSERT_EQ(Deque::parallel_reduce(pool, dq, 0LL, [](long long left, long long right) { return left + right; }),
+                  4999950000LL);
+    }
+
+    TEST(Stats, CountsOperationsAndReallocations) {
+        typedef Deque::Deque <int, std::allocator <int>, Deque::DefaultGrowthPolicy, Deque::ThrowingChecks,
+                              Deque::CollectStats> CountingDeque;
+
+        static_assert(sizeof(Deque::Deque <int>) < sizeof(CountingDeque), "NoStats keeps no counters");
+
+        CountingDeque dq;
+
+        for (int i = 0; i < 100000; ++i)
+            dq.push_back(i);
+
+        for (int i = 0; i < 50000; ++i)
+            dq.push_front(i);
+
+        std::vector <int> more(1000, 7);
+        dq.append(more.begin(), more.end());
+        dq.insert(dq.cbegin() + 10, more.begin(), more.begin() + 5);
+        dq.insert(dq.cend() - 10, more.begin(), more.begin() + 5);
+        dq.emplace(dq.cbegin() + 1, 3);
+        dq.prepend(more.begin(), more.begin() + 2);
+        dq.pop_front_n(13);
+
+        for (int i = 0; i < 20000; ++i)
+            dq.pop_front();
+
+        dq.pop_back_n(100);
+
+        const Deque::DequeStats &stats = dq.stats();
+
+        ASSERT_EQ(stats.push_back, 101000u);
+        ASSERT_EQ(stats.push_front, 50002u);
+        ASSERT_EQ(stats.inserts, 11u);
+        ASSERT_EQ(stats.pop_front, 20013u);
+        ASSERT_EQ(stats.pop_back, 100u);
+        ASSERT_EQ(stats.peak_size, 151013u);
+        ASSERT_GE(stats.peak_capacity, 151000u);
+        ASSERT_GT(stats.reallocation_count(Deque::ReallocationType::RT_INCREASE), 0u);
+        ASSERT_EQ(stats.reallocation_count(Deque::ReallocationType::RT_DECREASE), 0u);
+        ASSERT_GT(stats.bytes_copied, 0u);
+
+        size_t timed = 0;
+
+        for (size_t bucket : stats.reallocation_ns_histogram)
+            timed += bucket;
+
+        ASSERT_EQ(timed, stats.reallocation_count(Deque::ReallocationType::RT_INCREASE));
+
+        // a FIFO in steady state hands blocks from the front to the back instead of reallocating
+        dq.reset_stats();
+        ASSERT_EQ(dq.stats().push_back, 0u);
+        ASSERT_EQ(dq.stats().peak_size, dq.size());
+
+        for (int i = 0; i < 100000; ++i) {
+            dq.push_back(i);
+            dq.pop_front();
+        }
+
+        ASSERT_EQ(dq.stats().reallocation_count(Deque::ReallocationType::RT_INCREASE), 0u);
+        ASSERT_GT(dq.stats().reallocation_count(Deque::ReallocationType::RT_STAY), 0u);
+
+        while (!dq.empty())
+            dq.pop_back();
+
+        ASSERT_GT(dq.stats().reallocation_count(Deque::ReallocationType::RT_DECREASE), 0u);
+        ASSERT_EQ(dq.stats().pop_back, 131000u - 100u);
+    }
+
+    TEST(Stats, IncrementalResizesCountPointersAsTheyMove) {
+        typedef Deque::Deque <int, std::allocator <int>, Deque::IncrementalGrowthPolicy, Deque::ThrowingChecks,
+                              Deque::CollectStats> CountingDeque;
+
+        CountingDeque dq;
+        const size_t step_bytes = Deque::IncrementalGrowthPolicy::kMigrationStep * sizeof(int *);
+
+        // even the push that resizes moves no more than one step's worth of pointers
+        for (int i = 0; i < 1000000; ++i) {
+            size_t copied = dq.stats().bytes_copied;
+
+            dq.push_back(i);
+            ASSERT_LE(dq.stats().bytes_copied - copied, step_bytes);
+        }
+
+        ASSERT_GT(dq.stats().reallocation_count(Deque::ReallocationType::RT_INCREASE), 2u);
+        ASSERT_GT(dq.stats().bytes_copied, 0u);
+    }
+
+    TEST(Incremental, MatchesStdDequeWhileMigrating) {
+        typedef Deque::Deque <int, std::allocator <int>, Deque::IncrementalGrowthPolicy> IncrementalDeque;
+
+        std::mt19937 random(23);
+        IncrementalDeque dq;
+        std::deque <int> expected;
+
+        for (int step = 0; step < 400000; ++step) {
+            int value = static_cast<int>(random() % 1000000);
+
+            switch (random() % 16) {
+                case 0:
+                case 1:
+                case 2:
+                case 3:
+                case 4:
+                    dq.push_back(value);
+                    expected.push_back(value);
+                    break;
+                case 5:
+                case 6:
+                case 7:
+                case 8:
+                    dq.push_front(value);
+                    expected.push_front(value);
+                    break;
+                case 9:
+                case 10:
+                    if (!expected.empty()) {
+                        dq.pop_front();
+                        expected.pop_front();
+                    }
+                    break;
+                case 11:
+                case 12:
+                    if (!expected.empty()) {
+                        dq.pop_back();
+                        expected.pop_back();
+                    }
+                    break;
+                case 13:
+                    if (!expected.empty()) {
+                        size_t index = random() % expected.size();
+                        ASSERT_EQ(dq[index], expected[index]);
+                        dq[index] = value;
+                        expected[index] = value;
+                    }
+                    break;
+                case 14:
+                    if (step % 1000 == 14) {
+                        size_t count = random() % (expected.size() + 1);
+                        dq.pop_front_n(count);
+                        expected.erase(expected.begin(), expected.begin() + count);
+                    }
+                    break;
+                default:
+                    if (step % 5000 == 15) {
+                        ASSERT_TRUE(std::equal(expected.begin(), expected.end(), dq.begin()));
+                        ASSERT_TRUE(std::equal(expected.rbegin(), expected.rend(), dq.rbegin()));
+
+                        IncrementalDeque moved(std::move(dq));
+                        dq = moved;
+                    }
+                    break;
+            }
+        }
+
+        ASSERT_EQ(dq.size(), expected.size());
+        ASSERT_TRUE(std::equal(expected.begin(), expected.end(), dq.begin()));
+
+        dq.shrink_to_fit();
+        ASSERT_TRUE(std::equal(expected.begin(), expected.end(), dq.begin()));
+
+        dq.clear();
+
+        // resizes of a large map take many pushes to finish, every element stays reachable meanwhile
+        for (int i = 0; i < 2000000; ++i) {
+            dq.push_front(i);
+
+            size_t index = random() % dq.size();
+            ASSERT_EQ(dq[index], i - static_cast<int>(index));
+        }
+
+        for (int i = 0; i < 2000000; ++i) {
+            ASSERT_EQ(dq.back(), i);
+            dq.pop_back();
+        }
+
+        ASSERT_TRUE(dq.empty());
+    }
+
+    TEST(SlidingWindow, MatchesRescanOfTheWindow) {
+        std::mt19937 random(24);
+        Deque::SlidingWindow <int, Deque::MinOf <int>> minimum;
+        Deque::SlidingWindow <int, Deque::MaxOf <int>> maximum;
+        Deque::SlidingWindow <long long, std::plus <long long>> sum;
+        // not commutative, so the window has to fold its items oldest first
+        Deque::SlidingWindow <std::string, std::plus <std::string>> concatenation;
+        std::deque <int> window;
+
+        for (int step = 0; step < 200000; ++step) {
+            int value = static_cast<int>(random() % 1000);
+            minimum.push(value);
+            maximum.push(value);
+            sum.push(value);
+            concatenation.push(std::to_string(value % 10));
+            window.push_back(value);
+
+            size_t keep = random() % 64;
+
+            if (random() % 4 == 0 && window.size() > keep) {
+                size_t evicted = window.size() - keep;
+                minimum.keep_last(keep);
+                maximum.keep_last(keep);
+                sum.pop_n(evicted);
+                concatenation.pop_n(evicted);
+                window.erase(window.begin(), window.begin() + evicted);
+            }
+
+            ASSERT_EQ(minimum.size(), window.size());
+
+            if (window.empty()) {
+                ASSERT_THROW(minimum.value(), decltype(minimum)::Errors);
+                continue;
+            }
+
+            ASSERT_EQ(minimum.value(), *std::min_element(window.begin(), window.end()));
+            ASSERT_EQ(maximum.value(), *std::max_element(window.begin(), window.end()));
+            ASSERT_EQ(sum.value(), std::accumulate(window.begin(), window.end(), 0ll));
+
+            if (step % 97 == 0) {
+                std::string expected;
+
+                for (int item : window)
+                    expected += std::to_string(item % 10);
+
+                ASSERT_EQ(concatenation.value(), expected);
+            }
+        }
+    }
+
+    TEST(SlidingWindow, EvictsByKey) {
+        Deque::SlidingWindow <double, Deque::MaxOf <double>, long long> last_second;
+        Deque::SlidingWindow <double, std::plus <double>, long long> total;
+        long long timestamps[] = {0, 100, 100, 700, 1200, 1200, 1900, 2500};
+        double values[] = {5, 1, 2, 9, 3, 4, 0.5, 7};
+
+        for (size_t i = 0; i < 8; ++i) {
+            last_second.evict_before(timestamps[i] - 1000);
+            total.evict_before(timestamps[i] - 1000);
+            last_second.push(timestamps[i], values[i]);
+            total.push(timestamps[i], values[i]);
+        }
+
+        // items at 1900 ms and later fall in the last second
+        ASSERT_EQ(last_second.size(), 2u);
+        ASSERT_EQ(last_second.front_key(), 1900);
+        ASSERT_EQ(last_second.value(), 7);
+        ASSERT_EQ(total.value(), 7.5);
+
+        ASSERT_EQ(total.evict_before(3000), 2u);
+        ASSERT_TRUE(total.empty());
+        ASSERT_THROW(last_second.push(2000, 1), decltype(last_second)::Errors);
+        ASSERT_THROW(last_second.pop_n(3), decltype(last_second)::Errors);
+    }
+
+    TEST(Ring, RejectWhenFull) {
+        Deque::RingDeque <int> ring(5);
+
+        for (int i = 0; i < 5; ++i)
+            ring.push_back(i);
+
+        ASSERT_TRUE(ring.full());
+        ASSERT_THROW(ring.push_back(5), Deque::RingDeque <int>::Errors);
+        ASSERT_THROW(ring.push_front(5), Deque::RingDeque <int>::Errors);
+        ASSERT_FALSE(ring.try_push_back(5));
+
+        ring.pop_front();
+        ASSERT_TRUE(ring.try_push_front(-1));
+        ASSERT_EQ(ring.front(), -1);
+        ASSERT_EQ(ring.back(), 4);
+    }
+
+    TEST(Ring, OverwriteOldest) {
+        AllocationCounter counter;
+        Deque::RingDeque <int, Deque::OverwriteOnOverflow, CountingAllocator <int>>
+                ring(1000, CountingAllocator <int>(&counter));
+        std::deque <int> dq_std;
+
+        ASSERT_EQ(counter.allocations, 1u);
+
+        for (int i = 0; i < static_cast<int>(numberOfElements); ++i) {
+            if (i % 7 == 0) {
+                ring.push_front(i);
+                dq_std.push_front(i);
+            } else {
+                ring.push_back(i);
+                dq_std.push_back(i);
+            }
+
+            if (dq_std.size() > 1000) {
+                if (i % 7 == 0)
+                    dq_std.pop_back();
+                else
+                    dq_std.pop_front();
+            }
+
+            if (i % 13 == 0) {
+                ring.pop_back();
+                dq_std.pop_back();
+            }
+        }
+
+        ASSERT_EQ(counter.allocations, 1u);
+        ASSERT_EQ(ring.size(), dq_std.size());
+        ASSERT_TRUE(std::equal(dq_std.begin(), dq_std.end(), ring.begin()));
+        ASSERT_TRUE(std::equal(dq_std.rbegin(), dq_std.rend(), ring.crbegin()));
+
+        Deque::Span <const int> spans[2] = {};
+        ASSERT_EQ(ring.readable_spans(spans, 2), 2u);
+        ASSERT_EQ(spans[0].size + spans[1].size, ring.size());
+        ASSERT_EQ(*spans[0].data, ring.front());
+    }
+
+    TEST(Ring, DestroysOverwrittenElements) {
+        {
+            Deque::RingDeque <Counted, Deque::OverwriteOnOverflow> ring(3);
+
+            for (int i = 0; i < 10; ++i)
+                ring.emplace_back(i);
+
+            ASSERT_EQ(Counted::alive, 3);
+            ASSERT_EQ(ring.front().value, 7);
+
+            Deque::RingDeque <Counted, Deque::OverwriteOnOverflow> copy(ring);
+            ASSERT_EQ(Counted::alive, 6);
+        }
+
+        ASSERT_EQ(Counted::alive, 0);
+    }
+
+    struct ThrowsOnNegative {
+        std::string value;
+
+        explicit ThrowsOnNegative(int v) : value(std::to_string(v)) {
+            if (v < 0)
+                throw std::runtime_error("negative");
+        }
+    };
+
+    TEST(Ring, OverwriteFromOwnElements) {
+        // 4 is a power of two, so the new element reuses the evicted slot; 5 leaves a slot free
+        for (size_t capacity : {4, 5}) {
+            Deque::RingDeque <std::string, Deque::OverwriteOnOverflow> ring(capacity);
+
+            for (size_t i = 0; i < capacity; ++i)
+                ring.push_back(std::string(32, static_cast<char>('a' + i)));
+
+            ring.push_back(ring.front());
+            ASSERT_EQ(ring.back(), std::string(32, 'a'));
+            ASSERT_EQ(ring.front(), std::string(32, 'b'));
+
+            ring.push_front(ring.back());
+            ASSERT_EQ(ring.front(), std::string(32, 'a'));
+            ASSERT_EQ(ring.back(), std::string(32, static_cast<char>('a' + capacity - 1)));
+            ASSERT_EQ(ring.size(), capacity);
+
+            Deque::RingDeque <ThrowsOnNegative, Deque::OverwriteOnOverflow> throwing(capacity);
+
+            for (size_t i = 0; i < capacity; ++i)
+                throwing.emplace_back(static_cast<int>(i));
+
+            ASSERT_THROW(throwing.emplace_back(-1), std::runtime_error);
+            ASSERT_THROW(throwing.emplace_front(-1), std::runtime_error);
+            ASSERT_EQ(throwing.size(), capacity);
+            ASSERT_EQ(throwing.front().value, "0");
+            ASSERT_EQ(throwing.back().value, std::to_string(capacity - 1));
+        }
+    }
+
+    template <typename T>
+    struct PropagatingAllocator : CountingAllocator <T> {
+        typedef std::true_type propagate_on_container_copy_assignment;
+        typedef std::true_type propagate_on_container_move_assignment;
+        typedef std::true_type propagate_on_container_swap;
+
+        explicit PropagatingAllocator(AllocationCounter *c) : CountingAllocator <T>(c) {}
+
+        template <typename U>
+        PropagatingAllocator(const PropagatingAllocator <U> &other) : CountingAllocator <T>(other.counter) {}
+    };
+
+    TEST(Ring, PropagatesAllocator) {
+        typedef Deque::RingDeque <int, Deque::RejectOnOverflow, PropagatingAllocator <int>> Ring;
+        AllocationCounter first_counter, second_counter;
+        Ring first(8, PropagatingAllocator <int>(&first_counter));
+        Ring second(8, PropagatingAllocator <int>(&second_counter));
+
+        first.push_back(1);
+        second.push_back(2);
+        first.swap(second);
+
+        ASSERT_EQ(first.get_allocator().counter, &second_counter);
+        ASSERT_EQ(first.front(), 2);
+
+        first = second;
+        ASSERT_EQ(first.get_allocator().counter, &first_counter);
+        ASSERT_EQ(first.front(), 1);
+        ASSERT_EQ(second_counter.live_bytes, 0u);
+        ASSERT_EQ(first_counter.live_bytes, 2 * 8 * sizeof(int));
+
+        second = std::move(first);
+        ASSERT_EQ(second.get_allocator().counter, &first_counter);
+        ASSERT_EQ(second.front(), 1);
+        ASSERT_EQ(first_counter.live_bytes, 8 * sizeof(int));
+    }
+
+    struct ThrowingCopy {
+        static int alive;
+        static int copies_left;
+        int value;
+
+        explicit ThrowingCopy(int v) : value(v) {
+            ++alive;
+        }
+
+        ThrowingCopy(const ThrowingCopy &other) : value(other.value) {
+            if (copies_left-- == 0)
+                throw std::runtime_error("copy");
+
+            ++alive;
+        }
+
+        ~ThrowingCopy() {
+            --alive;
+        }
+    };
+
+    int ThrowingCopy::alive = 0;
+    int ThrowingCopy::copies_left = 1000;
+
+    TEST(Spsc, BoundedRejectsWhenFull) {
+        Deque::BoundedSpscQueue <int> queue(5);
+        int values[] = {0, 1, 2, 3, 4, 5, 6};
+
+        ASSERT_EQ(queue.try_push_n(values, 3), 3u);
+        ASSERT_TRUE(queue.try_push(3));
+        ASSERT_EQ(queue.try_push_n(values + 4, 3), 1u);
+        ASSERT_FALSE(queue.try_push(5));
+        ASSERT_EQ(queue.size_approx(), 5u);
+
+        int out[5] = {};
+
+        ASSERT_EQ(queue.try_pop_n(out, 2), 2u);
+        ASSERT_EQ(out[0], 0);
+        ASSERT_EQ(out[1], 1);
+        ASSERT_TRUE(queue.try_push(5));
+
+        for (int expected = 2; expected < 6; ++expected) {
+            int value = -1;
+            ASSERT_TRUE(queue.try_pop(value));
+            ASSERT_EQ(value, expected);
+        }
+
+        int value;
+        ASSERT_FALSE(queue.try_pop(value));
+        ASSERT_EQ(queue.try_pop_n(out, 5), 0u);
+    }
+
+    // the producer pushes 0, 1, 2, ... singly and in batches; the consumer checks it sees them in order
+    template <typename Push>
+    void transferInOrder(Push push, std::function <size_t(int *, size_t)> pop) {
+        const int items = 300000;
+
+        std::thread producer([&push] {
+            int batch[37];
+
+            for (int i = 0; i < items;) {
+                if (i % 3) {
+                    push(&i, 1);
+                    ++i;
+                } else {
+                    int count = std::min(37, items - i);
+
+                    for (int j = 0; j < count; ++j)
+                        batch[j] = i + j;
+
+                    push(batch, count);
+                    i += count;
+                }
+            }
+        });
+
+        int batch[16];
+
+        for (int expected = 0; expected < items;) {
+            size_t count = pop(batch, 16);
+
+            if (!count)
+                std::this_thread::yield();
+
+            for (size_t j = 0; j < count; ++j)
+                ASSERT_EQ(batch[j], expected++);
+        }
+
+        producer.join();
+    }
+
+    TEST(Spsc, BoundedTransfersInOrder) {
+        Deque::BoundedSpscQueue <int> queue(100);
+
+        transferInOrder([&queue](int *values, size_t n) {
+            for (size_t done = 0; (done += queue.try_push_n(values + done, n - done)) < n;)
+                std::this_thread::yield();
+        }, [&queue](int *out, size_t n) {
+            return n % 2 ? queue.try_pop(*out) : queue.try_pop_n(out, n);
+        });
+    }
+
+    TEST(Spsc, GrowableTransfersInOrder) {
+        Deque::SpscQueue <int> queue;
+
+        transferInOrder([&queue](int *values, size_t n) {
+            if (n == 1)
+                queue.push(*values);
+            else
+                queue.push_n(values, n);
+        }, [&queue](int *out, size_t n) {
+            return queue.try_pop_n(out, n);
+        });
+
+        ASSERT_EQ(queue.size_approx(), 0u);
+    }
+
+    TEST(Spsc, DestroysRemainingElements) {
+        {
+            Deque::BoundedSpscQueue <Counted> bounded(10);
+            Deque::SpscQueue <Counted> growable;
+
+            for (int i = 0; i < 10000; ++i) {
+                bounded.try_emplace(i);
+                growable.emplace(i);
+            }
+
+            Counted out(0);
+
+            for (int i = 0; i < 5000; ++i)
+                ASSERT_TRUE(growable.try_pop(out));
+
+            ASSERT_EQ(out.value, 4999);
+            ASSERT_TRUE(bounded.try_pop(out));
+            ASSERT_EQ(Counted::alive, 10 - 1 + 5000 + 1);
+        }
+
+        ASSERT_EQ(Counted::alive, 0);
+    }
+
+    TEST(Spsc, ThrowingPushesLoseNothing) {
+        {
+            Deque::BoundedSpscQueue <ThrowingCopy> bounded(8);
+            Deque::SpscQueue <ThrowingCopy> growable;
+            std::vector <ThrowingCopy> values;
+
+            for (int i = 0; i < 8; ++i)
+                values.emplace_back(i);
+
+            ThrowingCopy::copies_left = 2;
+            ASSERT_THROW(bounded.try_push_n(values.begin(), 5), std::runtime_error);
+            ThrowingCopy::copies_left = 1000;
+            ASSERT_EQ(bounded.size_approx(), 2u);
+            ASSERT_EQ(bounded.try_push_n(values.begin() + 2, 6), 6u);
+
+            ThrowingCopy out(-1);
+
+            for (int i = 0; i < 8; ++i) {
+                ASSERT_TRUE(bounded.try_pop(out));
+                ASSERT_EQ(out.value, i);
+            }
+
+            // fill the first segment, then fail on the first slot of the next one, singly and in a batch
+            const int segment = 4096;
+
+            for (int i = 0; i < segment; ++i)
+                growable.emplace(i);
+
+            ThrowingCopy::copies_left = 0;
+            ASSERT_THROW(growable.push(ThrowingCopy(segment)), std::runtime_error);
+            ThrowingCopy::copies_left = 0;
+            ASSERT_THROW(growable.push_n(values.begin(), 3), std::runtime_error);
+            ThrowingCopy::copies_left = 1000;
+
+            growable.push(ThrowingCopy(segment));
+            growable.push_n(values.begin(), 3);
+            ASSERT_EQ(ThrowingCopy::alive, 8 + 1 + segment + 4);
+
+            for (int i = 0; i <= segment; ++i) {
+                ASSERT_TRUE(growable.try_pop(out));
+                ASSERT_EQ(out.value, i);
+            }
+
+            for (int i = 0; i < 3; ++i) {
+                ASSERT_TRUE(growable.try_pop(out));
+                ASSERT_EQ(out.value, i);
+            }
+
+            ASSERT_FALSE(growable.try_pop(out));
+        }
+
+        ASSERT_EQ(ThrowingCopy::alive, 0);
+    }
+
+    TEST(WorkStealing, OwnerTakesNewestThievesTakeOldest) {
+        Deque::WorkStealingDeque <int> deque(4);
+
+        for (int i = 0; i < 100; ++i)
+            deque.push_back(i);
+
+        int value = -1;
+
+        ASSERT_EQ(deque.size_approx(), 100u);
+        ASSERT_TRUE(deque.steal(value));
+        ASSERT_EQ(value, 0);
+        ASSERT_TRUE(deque.pop_back(value));
+        ASSERT_EQ(value, 99);
+
+        for (int expected = 98; expected > 0; --expected) {
+            ASSERT_TRUE(deque.pop_back(value));
+            ASSERT_EQ(value, expected);
+        }
+
+        ASSERT_FALSE(deque.pop_back(value));
+        ASSERT_FALSE(deque.steal(value));
+        ASSERT_TRUE(deque.empty());
+    }
+
+    // the owner pushes 0, 1, 2, ... and pops some of them back while thieves steal; every value has to
+    // be taken by exactly one thread
+    TEST(WorkStealing, EveryElementTakenOnce) {
+        const int items = 200000;
+        const size_t thieves = 3;
+
+        Deque::WorkStealingDeque <int> deque(2);
+        std::vector <std::vector <int>> taken(thieves + 1);
+        std::atomic <bool> done{false};
+        std::vector <std::thread> threads;
+
+        for (size_t t = 0; t < thieves; ++t)
+            threads.emplace_back([&deque, &done, &taken, t] {
+                int value;
+
+                while (!done.load() || !deque.empty())
+                    if (deque.steal(value))
+                        taken[t].push_back(value);
+                    else
+                        std::this_thread::yield();
+            });
+
+        int value;
+
+        for (int i = 0; i < items; ++i) {
+            deque.push_back(i);
+
+            if (i % 3 == 0 && deque.pop_back(value))
+                taken[thieves].push_back(value);
+        }
+
+        while (deque.pop_back(value))
+            taken[thieves].push_back(value);
+
+        done = true;
+
+        for (std::thread &thread : threads)
+            thread.join();
+
+        std::vector <int> all;
+
+        for (const std::vector <int> &part : taken)
+            all.insert(all.end(), part.begin(), part.end());
+
+        std::sort(all.begin(), all.end());
+        ASSERT_EQ(all.size(), static_cast<size_t>(items));
+
+        for (int i = 0; i < items; ++i)
+            ASSERT_EQ(all[i], i);
+    }
+
+    TEST(Concurrent, BothEndsAndTimeouts) {
+        Deque::ConcurrentDeque <std::string> deque;
+        std::string value;
+
+        ASSERT_FALSE(deque.try_pop_front(value));
+        ASSERT_FALSE(deque.pop_back(value, std::chrono::milliseconds(10)));
+
+        ASSERT_TRUE(deque.try_push_back("b"));
+        ASSERT_TRUE(deque.try_push_front("a"));
+        ASSERT_TRUE(deque.try_emplace_back(1, 'c'));
+        ASSERT_EQ(deque.size_approx(), 3u);
+
+        ASSERT_TRUE(deque.try_pop_front(value));
+        ASSERT_EQ(value, "a");
+        ASSERT_TRUE(deque.pop_back(value, std::chrono::milliseconds(10)));
+        ASSERT_EQ(value, "c");
+
+        deque.close();
+        ASSERT_FALSE(deque.try_push_back("d"));
+        ASSERT_TRUE(deque.pop_front(value, std::chrono::seconds(10)));
+        ASSERT_EQ(value, "b");
+        ASSERT_FALSE(deque.pop_front(value, std::chrono::seconds(10)));
+        ASSERT_TRUE(deque.empty());
+    }
+
+    TEST(Concurrent, MatchesStdDequeAcrossBlocks) {
+        std::mt19937 random(11);
+        Deque::ConcurrentDeque <int> deque;
+        std::deque <int> expected;
+        int value;
+
+        // a size that drifts around zero makes both ends cross the same block boundaries back and forth
+        for (int step = 0; step < 200000; ++step) {
+            switch (random() % 4) {
+                case 0:
+                    ASSERT_TRUE(deque.try_push_back(step));
+                    expected.push_back(step);
+                    break;
+                case 1:
+                    ASSERT_TRUE(deque.try_push_front(step));
+                    expected.push_front(step);
+                    break;
+                case 2:
+                    ASSERT_EQ(deque.try_pop_front(value), !expected.empty());
+
+                    if (!expected.empty()) {
+                        ASSERT_EQ(value, expected.front());
+                        expected.pop_front();
+                    }
+                    break;
+                default:
+                    ASSERT_EQ(deque.try_pop_back(value), !expected.empty());
+
+                    if (!expected.empty()) {
+                        ASSERT_EQ(value, expected.back());
+                        expected.pop_back();
+                    }
+                    break;
+            }
+        }
+
+        ASSERT_EQ(deque.size_approx(), expected.size());
+    }
+
+    // the ends are those of the whole deque, not of the pushing thread
+    TEST(Concurrent, OneOrderAcrossThreads) {
+        const int count = 10000;
+        Deque::ConcurrentDeque <int> deque;
+
+        std::thread([&deque] {
+            for (int i = 0; i < count; ++i)
+                deque.try_push_back(i);
+        }).join();
+
+        std::thread([&deque] {
+            for (int i = 1; i <= count; ++i)
+                deque.try_push_front(-i);
+        }).join();
+
+        int value;
+
+        for (int expected = -count; expected < count / 2; ++expected) {
+            ASSERT_TRUE(deque.try_pop_front(value));
+            ASSERT_EQ(value, expected);
+        }
+
+        std::thread([&deque] {
+            int value;
+
+            for (int expected = count - 1; expected >= count / 2; --expected) {
+                ASSERT_TRUE(deque.try_pop_back(value));
+                ASSERT_EQ(value, expected);
+            }
+        }).join();
+
+        ASSERT_TRUE(deque.empty());
+    }
+
+    // producers push distinct values at both ends while consumers block on both ends until the deque
+    // is closed and drained; every value has to come out exactly once, and the values one producer
+    // pushes at the back leave through the front in the order pushed
+    TEST(Concurrent, StressManyProducersAndConsumers) {
+        const int producers = 4;
+        const int consumers = 4;
+        const int perProducer = 20000;
+
+        Deque::ConcurrentDeque <int> deque;
+        std::vector <std::vector <int>> taken(consumers);
+        std::vector <std::thread> threads;
+
+        for (int c = 0; c < consumers; ++c)
+            threads.emplace_back([&deque, &taken, c] {
+                int value;
+
+                while (c % 2 ? deque.pop_back(value, std::chrono::seconds(10))
+                             : deque.pop_front(value, std::chrono::seconds(10)))
+                    taken[c].push_back(value);
+            });
+
+        std::vector <std::thread> pushers;
+
+        for (int p = 0; p < producers; ++p)
+            pushers.emplace_back([&deque, p] {
+                for (int i = 0; i < perProducer; ++i) {
+                    int value = p * perProducer + i;
+                    ASSERT_TRUE(i % 2 ? deque.try_push_back(value) : deque.try_push_front(value));
+                }
+            });
+
+        for (std::thread &thread : pushers)
+            thread.join();
+
+        deque.close();
+
+        for (std::thread &thread : threads)
+            thread.join();
+
+        for (int c = 0; c < consumers; c += 2) {
+            std::vector <int> last(producers, -1);
+
+            for (int value : taken[c])
+                if (value % 2) {
+                    ASSERT_LT(last[value / perProducer], value);
+                    last[value / perProducer] = value;
+                }
+        }
+
+        std::vector <int> all;
+
+        for (const std::vector <int> &part : taken)
+            all.insert(all.end(), part.begin(), part.end());
+
+        std::sort(all.begin(), all.end());
+        ASSERT_EQ(all.size(), static_cast<size_t>(producers * perProducer));
+
+        for (int i = 0; i < producers * perProducer; ++i)
+            ASSERT_EQ(all[i], i);
+    }
+
+    TEST(ConcurrentBag, LaneOrdersAndTimeouts) {
+        Deque::ConcurrentBag <std::string> bag(4);
+        std::string value;
+
+        ASSERT_FALSE(bag.try_pop(value));
+        ASSERT_FALSE(bag.pop(value, std::chrono::milliseconds(10), Deque::LaneOrder::LIFO));
+
+        ASSERT_TRUE(bag.try_push("a"));
+        ASSERT_TRUE(bag.try_push(std::string("b")));
+        ASSERT_TRUE(bag.try_emplace(1, 'c'));
+        ASSERT_EQ(bag.size_approx(), 3u);
+
+        // one thread's elements share a lane, so the orders hold
+        ASSERT_TRUE(bag.try_pop(value));
+        ASSERT_EQ(value, "a");
+        ASSERT_TRUE(bag.pop(value, std::chrono::milliseconds(10), Deque::LaneOrder::LIFO));
+        ASSERT_EQ(value, "c");
+
+        bag.close();
+        ASSERT_FALSE(bag.try_push("d"));
+        ASSERT_TRUE(bag.pop(value, std::chrono::seconds(10)));
+        ASSERT_EQ(value, "b");
+        ASSERT_FALSE(bag.pop(value, std::chrono::seconds(10)));
+        ASSERT_TRUE(bag.empty());
+    }
+
+    // producers push distinct values while consumers block in both lane orders until the bag is closed
+    // and drained; every value has to come out exactly once
+    TEST(ConcurrentBag, StressManyProducersAndConsumers) {
+        const int producers = 4;
+        const int consumers = 4;
+        const int perProducer = 20000;
+
+        Deque::ConcurrentBag <int> bag(2);
+        std::vector <std::vector <int>> taken(consumers);
+        std::vector <std::thread> threads;
+
+        for (int c = 0; c < consumers; ++c)
+            threads.emplace_back([&bag, &taken, c] {
+                Deque::LaneOrder order = c % 2 ? Deque::LaneOrder::LIFO : Deque::LaneOrder::FIFO;
+                int value;
+
+                while (bag.pop(value, std::chrono::seconds(10), order))
+                    taken[c].push_back(value);
+            });
+
+        std::vector <std::thread> pushers;
+
+        for (int p = 0; p < producers; ++p)
+            pushers.emplace_back([&bag, p] {
+                for (int i = 0; i < perProducer; ++i) {
+                    int value = p * perProducer + i;
+                    ASSERT_TRUE(i % 2 ? bag.try_push(value) : bag.try_emplace(value));
+                }
+            });
+
+        for (std::thread &thread : pushers)
+            thread.join();
+
+        bag.close();
+
+        for (std::thread &thread : threads)
+            thread.join();
+
+        std::vector <int> all;
+
+        for (const std::vector <int> &part : taken)
+            all.insert(all.end(), part.begin(), part.end());
+
+        std::sort(all.begin(), all.end());
+        ASSERT_EQ(all.size(), static_cast<size_t>(producers * perProducer));
+
+        for (int i = 0; i < producers * perProducer; ++i)
+            ASSERT_EQ(all[i], i);
+    }
+
+    TEST(Iterators, WalkBlocksInBothDirections) {
+        Deque::Deque <int> dq;
+        std::deque <int> expected;
+
+        for (int i = 0; i < 20000; ++i) {
+            if (i % 3) {
+                dq.push_back(i);
+                expected.push_back(i);
+            } else {
+                dq.push_front(i);
+                expected.push_front(i);
+            }
+        }
+
+        ASSERT_TRUE(std::equal(dq.begin(), dq.end(), expected.begin(), expected.end()));
+        ASSERT_TRUE(std::equal(dq.rbegin(), dq.rend(), expected.rbegin(), expected.rend()));
+        ASSERT_EQ(std::accumulate(dq.cbegin(), dq.cend(), 0LL), std::accumulate(expected.begin(), expected.end(), 0LL));
+
+        std::mt19937 random(7);
+        Deque::Deque <int>::iterator it = dq.begin();
+
+        for (int step = 0; step < 1000; ++step) {
+            long long target = random() % dq.size();
+            long long offset = static_cast<long long>(random() % dq.size()) - target;
+
+            it += target - (it - dq.begin());
+            ASSERT_EQ(*it, expected[target]);
+            ASSERT_EQ(it[offset], expected[target + offset]);
+            ASSERT_EQ(*(it + offset), expected[target + offset]);
+        }
+
+        Deque::Deque <int>::iterator last = dq.end();
+        --last;
+        ASSERT_EQ(*last, expected.back());
+        ASSERT_EQ(last - dq.begin(), static_cast<long long>(dq.size()) - 1);
+
+        std::sort(dq.begin(), dq.end());
+        std::sort(expected.begin(), expected.end());
+        ASSERT_TRUE(std::equal(dq.begin(), dq.end(), expected.begin(), expected.end()));
+    }
+
+    TEST(Iterators, WalkAroundTheRing) {
+        Deque::RingDeque <int> ring(6);
+
+        for (int i = 0; i < 20; ++i) {
+            if (ring.full())
+                ring.pop_front();
+
+            ring.push_back(i);
+        }
+
+        std::vector <int> forward(ring.begin(), ring.end());
+        std::vector <int> backward(ring.rbegin(), ring.rend());
+
+        ASSERT_EQ(forward, std::vector <int>({14, 15, 16, 17, 18, 19}));
+        ASSERT_EQ(backward, std::vector <int>({19, 18, 17, 16, 15, 14}));
+        ASSERT_EQ(ring.begin()[5], 19);
+        ASSERT_EQ(*(ring.end() - 6), 14);
+    }
+
+    TEST(Checking, AtThrowsOperatorIndexDoesNot) {
+        Deque::Deque <std::string> dq;
+        const Deque::Deque <std::string> &view = dq;
+
+        static_assert(std::is_same <decltype(view.front()), const std::string &>::value, "front() const by reference");
+        static_assert(std::is_same <decltype(view.back()), const std::string &>::value, "back() const by reference");
+
+        ASSERT_THROW(dq.at(0), Deque::Deque <std::string>::Errors);
+        ASSERT_THROW(dq.front(), Deque::Deque <std::string>::Errors);
+        ASSERT_THROW(dq.pop_back(), Deque::Deque <std::string>::Errors);
+
+        dq.push_back("front");
+        dq.push_back("back");
+
+        ASSERT_EQ(&view.front(), &dq[0]);
+        ASSERT_EQ(&view.back(), &view.at(1));
+        ASSERT_THROW(view.at(2), Deque::Deque <std::string>::Errors);
+        ASSERT_THROW(dq.pop_front_n(3), Deque::Deque <std::string>::Errors);
+    }
+
+    TEST(Checking, NoChecksPolicy) {
+        Deque::Deque <int, std::allocator <int>, Deque::DefaultGrowthPolicy, Deque::NoChecks> dq;
+        Deque::RingDeque <int, Deque::RejectOnOverflow, std::allocator <int>, Deque::NoChecks> ring(4);
+
+        dq.push_back(1);
+        ring.push_back(1);
+
+        ASSERT_EQ(dq.front(), 1);
+        ASSERT_EQ(ring.back(), 1);
+        ASSERT_THROW(dq.at(1), decltype(dq)::Errors);
+        ASSERT_THROW(ring.at(1), decltype(ring)::Errors);
+    }
+
+#ifndef NDEBUG
+    TEST(CheckingDeathTest, AssertingPolicy) {
+        Deque::Deque <int, std::allocator <int>, Deque::DefaultGrowthPolicy, Deque::AssertingChecks> dq;
+
+        dq.push_back(1);
+
+        ASSERT_EQ(dq[0], 1);
+        ASSERT_DEATH(dq[1], "precondition");
+        ASSERT_DEATH(*dq.end(), "precondition");
+        ASSERT_DEATH(dq.pop_front_n(2), "precondition");
+    }
+#endif
+
+    TEST(Small, StaysInlineUpToN) {
+        AllocationCounter counter;
+        Deque::SmallDeque <int, 16, CountingAllocator <int>> dq{CountingAllocator <int>(&counter)};
+
+        for (int round = 0; round < 100; ++round) {
+            for (int i = 0; i < 8; ++i) {
+                dq.push_back(i);
+                dq.push_front(-i);
+            }
+
+            ASSERT_EQ(dq.size(), 16u);
+            ASSERT_EQ(dq.front(), -7);
+            ASSERT_EQ(dq.back(), 7);
+            ASSERT_EQ(dq[8], 0);
+
+            while (!dq.empty())
+                dq.pop_back();
+        }
+
+        ASSERT_FALSE(dq.spilled());
+        ASSERT_EQ(counter.allocations, 0u);
+    }
+
+    TEST(Small, SpillsAndComesBack) {
+        Deque::SmallDeque <std::string, 4> dq;
+        std::deque <std::string> expected;
+
+        for (int i = 0; i < 4; ++i) {
+            dq.push_front(std::to_string(i));
+            expected.push_front(std::to_string(i));
+        }
+
+        // the argument lives in the inline storage that the spill moves away
+        dq.push_back(dq.front());
+        expected.push_back(expected.front());
+        ASSERT_TRUE(dq.spilled());
+
+        for (int i = 0; i < 1000; ++i) {
+            dq.push_back(std::to_string(i));
+            expected.push_back(std::to_string(i));
+        }
+
+        ASSERT_TRUE(std::equal(dq.begin(), dq.end(), expected.begin(), expected.end()));
+        ASSERT_TRUE(std::equal(dq.rbegin(), dq.rend(), expected.rbegin(), expected.rend()));
+
+        Deque::SmallDeque <std::string, 4> copy(dq);
+        ASSERT_TRUE(std::equal(copy.begin(), copy.end(), expected.begin(), expected.end()));
+
+        while (dq.size() > 3) {
+            dq.pop_front();
+            expected.pop_front();
+        }
+
+        dq.shrink_to_fit();
+        ASSERT_FALSE(dq.spilled());
+        ASSERT_TRUE(std::equal(dq.begin(), dq.end(), expected.begin(), expected.end()));
+
+        Deque::SmallDeque <std::string, 4> moved(std::move(dq));
+        ASSERT_TRUE(dq.empty());
+        ASSERT_EQ(moved.at(2), "999");
+
+        while (!copy.empty())
+            copy.pop_back();
+
+        ASSERT_FALSE(copy.spilled());
+        copy = moved;
+        ASSERT_EQ(copy.front(), expected.front());
+    }
+
+    TEST(Small, DestroysInlineElements) {
+        {
+            Deque::SmallDeque <Counted, 8> dq;
+
+            for (int i = 0; i < 6; ++i)
+                dq.emplace_back(i);
+
+            dq.pop_front();
+            ASSERT_EQ(Counted::alive, 5);
+        }
+
+        ASSERT_EQ(Counted::alive, 0);
+    }
+
+    TEST(Small, FailedUnspillKeepsHeapElements) {
+        {
+            Deque::SmallDeque <ThrowingCopy, 4> dq;
+
+            for (int i = 0; i < 6; ++i)
+                dq.emplace_back(i);
+
+            dq.pop_front();
+            dq.pop_front();
+            dq.pop_front();
+
+            ThrowingCopy::copies_left = 1;
+            ASSERT_THROW(dq.shrink_to_fit(), std::runtime_error);
+            ASSERT_TRUE(dq.spilled());
+            ASSERT_EQ(ThrowingCopy::alive, 3);
+            ASSERT_EQ(dq.size(), 3u);
+            ASSERT_EQ(dq[0].value, 3);
+            ASSERT_EQ(dq.back().value, 5);
+
+            ThrowingCopy::copies_left = 1000;
+            dq.shrink_to_fit();
+            ASSERT_FALSE(dq.spilled());
+            ASSERT_EQ(ThrowingCopy::alive, 3);
+            ASSERT_EQ(dq[2].value, 5);
+        }
+
+        ASSERT_EQ(ThrowingCopy::alive, 0);
+    }
+
+    TEST(Small, CopyAssignmentPropagatesAllocator) {
+        typedef Deque::SmallDeque <int, 4, PropagatingAllocator <int>> Small;
+        AllocationCounter left_counter, right_counter;
+        Small left{PropagatingAllocator <int>(&left_counter)};
+        Small right{PropagatingAllocator <int>(&right_counter)};
+
+        for (int i = 0; i < 100; ++i)
+            left.push_back(i);
+
+        right.push_back(7);
+        left = right;
+
+        ASSERT_EQ(left.get_allocator().counter, &right_counter);
+        ASSERT_EQ(left_counter.live_bytes, 0u);
+        ASSERT_FALSE(left.spilled());
+        ASSERT_EQ(left.size(), 1u);
+        ASSERT_EQ(left.front(), 7);
+
+        for (int i = 0; i < 100; ++i)
+            right.push_back(i);
+
+        Small other{PropagatingAllocator <int>(&left_counter)};
+        other = right;
+
+        ASSERT_EQ(other.get_allocator().counter, &right_counter);
+        ASSERT_TRUE(other.spilled());
+        ASSERT_EQ(other.size(), 101u);
+        ASSERT_EQ(other.back(), 99);
+    }
+
+    TEST(Small, MoveAssignmentPropagatesAllocator) {
+        typedef Deque::SmallDeque <int, 4, PropagatingAllocator <int>> Small;
+        AllocationCounter left_counter, right_counter;
+        Small left{PropagatingAllocator <int>(&left_counter)};
+        Small right{PropagatingAllocator <int>(&right_counter)};
+
+        for (int i = 0; i < 100; ++i)
+            left.push_back(i);
+
+        right.push_back(7);
+        left = std::move(right);
+
+        ASSERT_EQ(left.get_allocator().counter, &right_counter);
+        ASSERT_EQ(left_counter.live_bytes, 0u);
+        ASSERT_FALSE(left.spilled());
+        ASSERT_EQ(left.size(), 1u);
+        ASSERT_EQ(left.front(), 7);
+
+        Small spilled{PropagatingAllocator <int>(&left_counter)};
+
+        for (int i = 0; i < 100; ++i)
+            spilled.push_back(i);
+
+        left = std::move(spilled);
+
+        ASSERT_EQ(left.get_allocator().counter, &left_counter);
+        ASSERT_TRUE(left.spilled());
+        ASSERT_EQ(left.size(), 100u);
+        ASSERT_EQ(left.back(), 99);
+    }
+
+    TEST(Shared, CopiesShareUntilWritten) {
+        AllocationCounter counter;
+        Deque::SharedDeque <int, CountingAllocator <int>> dq{CountingAllocator <int>(&counter)};
+
+        for (int i = 0; i < 100000; ++i)
+            dq.push_back(i);
+
+        size_t allocations = counter.allocations;
+        size_t bytes = counter.live_bytes;
+        Deque::SharedDeque <int, CountingAllocator <int>> snapshot = dq.snapshot();
+
+        ASSERT_EQ(counter.allocations, allocations);
+
+        // one write clones the map and the one block it touches
+        dq[50000] = -1;
+        ASSERT_LE(counter.live_bytes - bytes, bytes / 10);
+        ASSERT_EQ(snapshot[50000], 50000);
+        const Deque::SharedDeque <int, CountingAllocator <int>> &view = dq;
+        ASSERT_EQ(view[50000], -1);
+
+        for (int i = 0; i < 1000; ++i) {
+            dq.pop_front();
+            dq.push_front(-i);
+            dq.pop_back();
+            snapshot.push_back(i);
+        }
+
+        ASSERT_EQ(dq.size(), 100000u - 1000);
+        ASSERT_EQ(dq.front(), -999);
+        ASSERT_EQ(dq[1], 1);
+        ASSERT_EQ(snapshot.size(), 101000u);
+        ASSERT_EQ(snapshot.front(), 0);
+        ASSERT_EQ(snapshot.back(), 999);
+        ASSERT_EQ(snapshot[99999], 99999);
+    }
+
+    // random operations on a deque and its snapshots, each compared with its own std::deque
+    TEST(Shared, SnapshotsBehaveLikeCopies) {
+        std::mt19937 random(11);
+        std::vector <Deque::SharedDeque <std::string>> shared(1);
+        std::vector <std::deque <std::string>> expected(1);
+
+        for (int step = 0; step < 20000; ++step) {
+            size_t which = random() % shared.size();
+            Deque::SharedDeque <std::string> &dq = shared[which];
+            std::deque <std::string> &model = expected[which];
+            std::string value = std::to_string(step);
+
+            switch (random() % 8) {
+                case 0:
+                case 1:
+                    dq.push_back(value);
+                    model.push_back(value);
+                    break;
+                case 2:
+                case 3:
+                    dq.push_front(value);
+                    model.push_front(value);
+                    break;
+                case 4:
+                    if (!model.empty()) {
+                        dq.pop_back();
+                        model.pop_back();
+                    }
+                    break;
+                case 5:
+                    if (!model.empty()) {
+                        dq.pop_front();
+                        model.pop_front();
+                    }
+                    break;
+                case 6:
+                    if (!model.empty()) {
+                        size_t index = random() % model.size();
+                        dq[index] = value;
+                        model[index] = value;
+                    }
+                    break;
+                default:
+                    if (shared.size() < 8) {
+                        shared.push_back(dq.snapshot());
+                        expected.push_back(model);
+                    } else {
+                        size_t other = random() % shared.size();
+                        shared[which] = shared[other];
+                        expected[which] = expected[other];
+                    }
+                    break;
+            }
+
+            if (step % 997 == 0) {
+                for (size_t i = 0; i < shared.size(); ++i)
+                    ASSERT_TRUE(std::equal(shared[i].begin(), shared[i].end(), expected[i].begin(), expected[i].end()));
+            }
+        }
+    }
+
+    TEST(Shared, ReleasesSharedElements) {
+        {
+            Deque::SharedDeque <Counted> dq;
+
+            for (int i = 0; i < 5000; ++i)
+                dq.emplace_back(i);
+
+            Deque::SharedDeque <Counted> copy(dq);
+
+            for (int i = 0; i < 2500; ++i)
+                dq.pop_front();
+
+            dq.front() = Counted(-1);
+            copy.clear();
+            dq.push_front(Counted(-2));
+        }
+
+        ASSERT_EQ(Counted::alive, 0);
+    }
+
+#ifdef DEQUE_HAS_PMR
+    TEST(Shared, AssignmentKeepsNonPropagatingAllocator) {
+        typedef Deque::SharedDeque <int, std::pmr::polymorphic_allocator <int>> PmrShared;
+        std::pmr::monotonic_buffer_resource arena;
+        PmrShared local(&arena);
+        PmrShared other;
+
+        for (int i = 0; i < 1000; ++i)
+            other.push_back(i);
+
+        // a pmr allocator never propagates, so the elements are copied into the arena
+        local = other;
+        ASSERT_EQ(local.get_allocator().resource(), &arena);
+        ASSERT_TRUE(std::equal(other.begin(), other.end(), local.begin(), local.end()));
+
+        other.front() = -1;
+        ASSERT_EQ(local.front(), 0);
+
+        local = std::move(other);
+        ASSERT_EQ(local.get_allocator().resource(), &arena);
+        ASSERT_EQ(local.front(), -1);
+        ASSERT_TRUE(other.empty());
+    }
+#endif
+
+    TEST(Shared, AssignmentPropagatesAllocator) {
+        typedef Deque::SharedDeque <int, PropagatingAllocator <int>> Propagating;
+        AllocationCounter left_counter, right_counter;
+        Propagating left{PropagatingAllocator <int>(&left_counter)};
+        Propagating right{PropagatingAllocator <int>(&right_counter)};
+
+        left.push_back(1);
+        right.push_back(2);
+
+        left = right;
+        ASSERT_EQ(left.get_allocator().counter, &right_counter);
+        ASSERT_EQ(left_counter.live_bytes, 0u);
+        ASSERT_EQ(left.front(), 2);
+
+        Propagating moved{PropagatingAllocator <int>(&left_counter)};
+
+        moved.push_back(3);
+        moved = std::move(right);
+        ASSERT_EQ(moved.get_allocator().counter, &right_counter);
+        ASSERT_EQ(left_counter.live_bytes, 0u);
+        ASSERT_EQ(moved.front(), 2);
+    }
+
+    TEST(Mapped, StaysWithinBudget) {
+        Deque::MappedDeque <int> dq("/tmp", 256 << 10, 64 << 10);
+        std::deque <int> expected;
+
+        for (int i = 0; i < 200000; ++i) {
+            if (i % 4) {
+                dq.push_back(i);
+                expected.push_back(i);
+            } else {
+                dq.push_front(i);
+                expected.push_front(i);
+            }
+
+            ASSERT_LE(dq.resident_segments(), 4u);
+        }
+
+        ASSERT_EQ(dq.size(), expected.size());
+        ASSERT_GT(dq.segments(), 10u);
+
+        std::mt19937 random(3);
+
+        for (int step = 0; step < 10000; ++step) {
+            size_t index = random() % expected.size();
+
+            ASSERT_EQ(dq[index], expected[index]);
+            dq[index] = step;
+            expected[index] = step;
+            ASSERT_LE(dq.resident_segments(), 4u);
+        }
+
+        while (expected.size() > 1000) {
+            ASSERT_EQ(dq.front(), expected.front());
+            ASSERT_EQ(dq.back(), expected.back());
+            dq.pop_front();
+            dq.pop_back();
+            expected.pop_front();
+            expected.pop_back();
+        }
+
+        ASSERT_LE(dq.segments(), 2u);
+
+        for (size_t i = 0; i < expected.size(); ++i)
+            ASSERT_EQ(dq.at(i), expected[i]);
+
+        ASSERT_THROW(dq.at(expected.size()), Deque::MappedDeque <int>::Errors);
+    }
+
+    TEST(Mapped, PushesElementOfEvictedSegment) {
+        // three resident segments: head, tail and one for random access
+        Deque::MappedDeque <int> dq("/tmp", 0, 4096);
+        size_t per_segment = dq.segment_elements();
+
+        for (size_t i = 0; i < 8 * per_segment; ++i)
+            dq.push_back(static_cast<int>(i));
+
+        // the tail segment is full, so both pushes map a new one and unmap the middle segment read from
+        dq.push_back(dq[per_segment + 5]);
+        ASSERT_EQ(dq.back(), static_cast<int>(per_segment + 5));
+
+        for (size_t i = 0; i < per_segment; ++i)
+            dq.pop_front();
+
+        dq.push_front(dq[3 * per_segment + 7]);
+        ASSERT_EQ(dq.front(), static_cast<int>(4 * per_segment + 7));
+        ASSERT_EQ(dq.resident_segments(), 3u);
+
+        const Deque::MappedDeque <int> &view = dq;
+        ASSERT_EQ(view[1], view.at(1));
+        ASSERT_EQ(view[1], static_cast<int>(per_segment));
+        ASSERT_EQ(view.back(), static_cast<int>(per_segment + 5));
+        ASSERT_THROW(view.at(view.size()), Deque::MappedDeque <int>::Errors);
+    }
+
+    TEST(Mapped, RecyclesSegments) {
+        Deque::MappedDeque <long long> dq("/tmp", 1 << 20, 4096);
+
+        for (long long round = 0; round < 50; ++round) {
+            for (long long i = 0; i < 10000; ++i)
+                dq.push_back(round * 10000 + i);
+
+            for (long long i = 0; i < 10000; ++i) {
+                ASSERT_EQ(dq.front(), round * 10000 + i);
+                dq.pop_front();
+            }
+        }
+
+        ASSERT_TRUE(dq.empty());
+        ASSERT_EQ(dq.segments(), 0u);
+        ASSERT_EQ(dq.resident_segments(), 0u);
+    }
+
+    template <typename Iterator>
+    void testLoop(Iterator begin, Iterator end, const std::vector <int> &expected) {
+        size_t steps = 0;
+
+        for (Iterator it = begin; it != end; ++it)
+            ASSERT_EQ(*it, expected[steps++]);
+
+        ASSERT_EQ(steps, expected.size());
+    }
+
+    TEST_F(Check, IteratorsLoop) {
+        fill(dq);
+
+        std::vector <int> expected;
 
-        double time = 0;
-        testLoop(dq->begin(), dq->end(), time);
-        ASSERT_LE(time / (dq->end() - dq->begin()), o1_time);
+        for (size_t i = 0; i < dq->size(); ++i)
+            expected.push_back((*dq)[i]);
 
-        time = 0;
-        testLoop(dq->cbegin(), dq->cend(), time);
-        ASSERT_LE(time / (dq->cend() - dq->cbegin()), o1_time);
+        testLoop(dq->begin(), dq->end(), expected);
+        testLoop(dq->cbegin(), dq->cend(), expected);
 
-        time = 0;
-        testLoop(dq->rbegin(), dq->rend(), time);
-        ASSERT_LE(time / (dq->rend() - dq->rbegin()), o1_time);
+        std::reverse(expected.begin(), expected.end());
 
-        time = 0;
-        testLoop(dq->crbegin(), dq->crend(), time);
-        ASSERT_LE(time / (dq->crend() - dq->crbegin()), o1_time);
+        testLoop(dq->rbegin(), dq->rend(), expected);
+        testLoop(dq->crbegin(), dq->crend(), expected);
     }
 
     TEST_F(Compare, StandardOperations) {
@@ -0,0 +1,218 @@
+/*
+ * Copyright [2016] [Eugeny Gostkin]
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied. See the License for the specific
+ * language governing permissions and limitations under the License.
+ *
+*/
+
+#ifndef WORK_STEALING_DEQUE_H
+#define WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+#include "deque.h"
+
+// Chase-Lev work-stealing deque. One owner thread pushes and pops at the back, any number of thieves
+// steal from the front. The owner's store of bottom and the thieves' loads of top and bottom are
+// sequentially consistent instead of relaxed accesses around a seq_cst fence as in Le et al., which
+// costs the same on x86 and keeps the code checkable by ThreadSanitizer. Elements are read by a thief before it knows
+// whether it won the race for them, so they have to be trivially copyable (typically task pointers).
+namespace Deque {
+    template <typename T, typename Allocator = std::allocator <T>>
+    class WorkStealingDeque {
+    private:
+        static_assert(std::is_trivially_copyable <T>::value, "WorkStealingDeque holds trivially copyable elements");
+
+        typedef std::int64_t Index;
+
+        struct Buffer {
+            Index mask;
+            std::atomic <T> *slots;
+            Buffer *retired;  // the buffer this one replaced, kept until no thief can be reading it
+
+            T get(Index position) const {
+                return slots[position & mask].load(std::memory_order_relaxed);
+            }
+
+            void put(Index position, T element) {
+                slots[position & mask].store(element, std::memory_order_relaxed);
+            }
+        };
+
+        typedef typename std::allocator_traits <Allocator>::template rebind_alloc <std::atomic <T>> SlotAllocator;
+        typedef typename std::allocator_traits <Allocator>::template rebind_alloc <Buffer> BufferAllocator;
+        typedef std::allocator_traits <SlotAllocator> SlotAllocatorTraits;
+        typedef std::allocator_traits <BufferAllocator> BufferAllocatorTraits;
+
+        SlotAllocator allocator_;
+
+        alignas(kCacheLineSize) std::atomic <Index> top_{0};
+        // thieves between reading buffer_ and finishing with it
+        alignas(kCacheLineSize) std::atomic <size_t> thieves_{0};
+        alignas(kCacheLineSize) std::atomic <Index> bottom_{0};
+        std::atomic <Buffer *> buffer_{nullptr};
+
+        Buffer *allocateBuffer(Index capacity) {
+            BufferAllocator allocator(allocator_);
+            Buffer *buffer = BufferAllocatorTraits::allocate(allocator, 1);
+            std::atomic <T> *slots;
+
+            try {
+                slots = SlotAllocatorTraits::allocate(allocator_, static_cast<size_t>(capacity));
+            } catch (...) {
+                BufferAllocatorTraits::deallocate(allocator, buffer, 1);
+                throw;
+            }
+
+            for (Index i = 0; i < capacity; ++i)
+                SlotAllocatorTraits::construct(allocator_, slots + i);
+
+            return ::new (static_cast<void *>(buffer)) Buffer{capacity - 1, slots, nullptr};
+        }
+
+        void deallocateBuffers(Buffer *buffer) {
+            BufferAllocator allocator(allocator_);
+
+            while (buffer) {
+                Buffer *retired = buffer->retired;
+                size_t capacity = static_cast<size_t>(buffer->mask + 1);
+
+                for (size_t i = 0; i < capacity; ++i)
+                    SlotAllocatorTraits::destroy(allocator_, buffer->slots + i);
+
+                SlotAllocatorTraits::deallocate(allocator_, buffer->slots, capacity);
+                buffer->~Buffer();
+                BufferAllocatorTraits::deallocate(allocator, buffer, 1);
+                buffer = retired;
+            }
+        }
+
+        // owner: doubles the buffer, copying the live range [top, bottom)
+        Buffer *grow(Buffer *buffer, Index bottom, Index top) {
+            Buffer *grown = allocateBuffer(2 * (buffer->mask + 1));
+
+            for (Index i = top; i < bottom; ++i)
+                grown->put(i, buffer->get(i));
+
+            grown->retired = buffer;
+            buffer_.store(grown, std::memory_order_seq_cst);
+
+            // a thief that registers after this load is ordered after the store above and sees the grown
+            // buffer, so if nobody is registered now the retired buffers are unreachable
+            if (thieves_.load(std::memory_order_seq_cst) == 0) {
+                deallocateBuffers(grown->retired);
+                grown->retired = nullptr;
+            }
+
+            return grown;
+        }
+
+    public:
+        typedef T value_type;
+
+        explicit WorkStealingDeque(size_t capacity = 64, const Allocator &allocator = Allocator()) :
+                allocator_(allocator) {
+            Index rounded = 1;
+
+            while (rounded < static_cast<Index>(capacity))
+                rounded *= 2;
+
+            buffer_.store(allocateBuffer(rounded), std::memory_order_relaxed);
+        }
+
+        WorkStealingDeque(const WorkStealingDeque &) = delete;
+        WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+        ~WorkStealingDeque() {
+            deallocateBuffers(buffer_.load(std::memory_order_relaxed));
+        }
+
+        // only exact when no thread is running
+        size_t size_approx() const {
+            Index size = bottom_.load(std::memory_order_relaxed) - top_.load(std::memory_order_relaxed);
+            return size > 0 ? static_cast<size_t>(size) : 0;
+        }
+
+        bool empty() const {
+            return size_approx() == 0;
+        }
+
+        // owner side
+
+        void push_back(T element) {
+            Index bottom = bottom_.load(std::memory_order_relaxed);
+            Index top = top_.load(std::memory_order_acquire);
+            Buffer *buffer = buffer_.load(std::memory_order_relaxed);
+
+            if (bottom - top > buffer->mask)
+                buffer = grow(buffer, bottom, top);
+
+            buffer->put(bottom, element);
+            bottom_.store(bottom + 1, std::memory_order_release);
+        }
+
+        // takes the most recently pushed element, returns false if the deque is empty
+        bool pop_back(T &element) {
+            Index bottom = bottom_.load(std::memory_order_relaxed) - 1;
+            Buffer *buffer = buffer_.load(std::memory_order_relaxed);
+
+            bottom_.store(bottom, std::memory_order_seq_cst);
+
+            Index top = top_.load(std::memory_order_seq_cst);
+
+            if (top > bottom) {
+                bottom_.store(bottom + 1, std::memory_order_relaxed);
+                return false;
+            }
+
+            element = buffer->get(bottom);
+
+            if (top < bottom)
+                return true;
+
+            // the last element: race the thieves for it
+            bool won = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                    std::memory_order_relaxed);
+
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return won;
+        }
+
+        // thief side
+
+        // takes the oldest element; returns false if the deque is empty or another thread got it first
+        bool steal(T &element) {
+            thieves_.fetch_add(1, std::memory_order_seq_cst);
+
+            Index top = top_.load(std::memory_order_seq_cst);
+            Index bottom = bottom_.load(std::memory_order_seq_cst);
+            bool stolen = false;
+
+            if (top < bottom) {
+                T candidate = buffer_.load(std::memory_order_seq_cst)->get(top);
+
+                if (top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                                 std::memory_order_relaxed)) {
+                    element = candidate;
+                    stolen = true;
+                }
+            }
+
+            thieves_.fetch_sub(1, std::memory_order_release);
+            return stolen;
+        }
+    };
+}
+
+#endif //WORK_STEALING_DEQUE_H